@@ -0,0 +1,41 @@
+#ifndef __MCIH_ARENA_H_
+#define __MCIH_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <memory>
+
+namespace ns3{
+  namespace mcih{
+    /*
+     * indexed pool of records allocated in fixed size chunks.
+     * growing never moves a record, so references stay valid until Clear, and no capacity is doubled.
+     */
+    template< typename T, uint32_t CHUNK_BITS= 6> class ChunkArena{
+      public:
+        static const uint32_t CHUNK= 1u<< CHUNK_BITS;
+
+        ChunkArena(): size( 0){
+        }
+        T& operator[]( uint32_t index){ return chunks[ index>> CHUNK_BITS][ index& ( CHUNK- 1)];}
+        const T& operator[]( uint32_t index) const{ return chunks[ index>> CHUNK_BITS][ index& ( CHUNK- 1)];}
+        size_t Size() const{ return size;}
+        uint32_t Push( const T &value){
+          if( size== chunks.size()* CHUNK) chunks.push_back( std::unique_ptr< T[]>( new T[ CHUNK]));
+          ( *this)[ size]= value;
+          return size++;
+        }
+        void Clear(){
+          chunks.clear();
+          size= 0;
+        }
+
+      private:
+        std::vector< std::unique_ptr< T[]> > chunks;
+        size_t size;
+    };
+  }
+}
+
+#endif // __MCIH_ARENA_H_
@@ -0,0 +1,74 @@
+#ifndef __MCIH_DUPLICATE_CACHE_H_
+#define __MCIH_DUPLICATE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "ns3/ipv6-address.h"
+
+namespace ns3{
+  namespace mcih{
+    /*
+     * the last CAPACITY ( source, sequence) pairs seen, oldest overwritten first.
+     * a counting bloom filter over the ring answers most misses without touching it,
+     * a hit of the filter is confirmed by a scan of the ring.
+     */
+    template< size_t CAPACITY= 256> class DuplicateCache{
+      public:
+        DuplicateCache(): next( 0), size( 0), counters( CAPACITY* 4, 0){
+          ring.resize( CAPACITY);
+        }
+        // true when the pair was seen already, otherwise it is remembered
+        bool IsDuplicate( Ipv6Address source, uint32_t sequence){
+          uint64_t hash= Hash( source, sequence);
+          if( counters[ First( hash)]&& counters[ Second( hash)]){
+            for( size_t index= 0; index< size; index++){
+              if( ring[ index].sequence== sequence&& ring[ index].source== source) return true;
+            }
+          }
+          if( size== CAPACITY){
+            uint64_t old= Hash( ring[ next].source, ring[ next].sequence);
+            counters[ First( old)]--;
+            counters[ Second( old)]--;
+          } else{
+            size++;
+          }
+          ring[ next].source= source;
+          ring[ next].sequence= sequence;
+          next= ( next+ 1)% CAPACITY;
+          counters[ First( hash)]++;
+          counters[ Second( hash)]++;
+          return false;
+        }
+        void Clear(){
+          next= 0;
+          size= 0;
+          counters.assign( counters.size(), 0);
+        }
+
+      private:
+        struct Key{
+          Ipv6Address source;
+          uint32_t sequence;
+          Key(): sequence( 0){
+          }
+        };
+        std::vector< Key> ring;
+        size_t next;
+        size_t size;
+        std::vector< uint16_t> counters;
+
+        static uint64_t Hash( Ipv6Address source, uint32_t sequence){
+          uint64_t hash= Ipv6AddressHash()( source)^ ( sequence* 0x9e3779b97f4a7c15ULL);
+          hash^= hash>> 29;
+          hash*= 0xbf58476d1ce4e5b9ULL;
+          return hash^ ( hash>> 32);
+        }
+        size_t First( uint64_t hash) const{ return hash% counters.size();}
+        size_t Second( uint64_t hash) const{ return ( hash>> 32)% counters.size();}
+    };
+  }
+}
+
+#endif // __MCIH_DUPLICATE_CACHE_H_
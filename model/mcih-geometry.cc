@@ -0,0 +1,85 @@
+#include <math.h>
+#include <algorithm>
+
+#if defined( __AVX__)
+#include <immintrin.h>
+#elif defined( __SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mcih-geometry.h"
+
+namespace ns3{
+  namespace mcih{
+#if defined( __AVX__)
+    static inline double HorizontalSum( __m256d v){
+      __m128d low= _mm256_castpd256_pd128( v);
+      __m128d high= _mm256_extractf128_pd( v, 1);
+      low= _mm_add_pd( low, high);
+      return _mm_cvtsd_f64( _mm_add_sd( low, _mm_unpackhi_pd( low, low)));
+    }
+    static inline double HorizontalMax( __m256d v){
+      __m128d low= _mm256_castpd256_pd128( v);
+      __m128d high= _mm256_extractf128_pd( v, 1);
+      low= _mm_max_pd( low, high);
+      return _mm_cvtsd_f64( _mm_max_sd( low, _mm_unpackhi_pd( low, low)));
+    }
+#elif defined( __SSE2__)
+    static inline double HorizontalSum( __m128d v){
+      return _mm_cvtsd_f64( _mm_add_sd( v, _mm_unpackhi_pd( v, v)));
+    }
+    static inline double HorizontalMax( __m128d v){
+      return _mm_cvtsd_f64( _mm_max_sd( v, _mm_unpackhi_pd( v, v)));
+    }
+#endif
+
+    double GetColumnSum( const double *value, size_t size){
+      size_t i= 0;
+      double sum= 0;
+#if defined( __AVX__)
+      __m256d acc= _mm256_setzero_pd();
+      for( ; i+ 4<= size; i+= 4) acc= _mm256_add_pd( acc, _mm256_loadu_pd( value+ i));
+      sum= HorizontalSum( acc);
+#elif defined( __SSE2__)
+      __m128d acc= _mm_setzero_pd();
+      for( ; i+ 2<= size; i+= 2) acc= _mm_add_pd( acc, _mm_loadu_pd( value+ i));
+      sum= HorizontalSum( acc);
+#endif
+      for( ; i< size; i++) sum+= value[ i];
+      return sum;
+    }
+
+    double GetColumnMaxDistance( const double *x, const double *y, size_t size, double origin_x, double origin_y){
+      // compares squared distances and takes one square root at the end
+      size_t i= 0;
+      double max= 0;
+#if defined( __AVX__)
+      const __m256d ox= _mm256_set1_pd( origin_x);
+      const __m256d oy= _mm256_set1_pd( origin_y);
+      __m256d acc= _mm256_setzero_pd();
+      for( ; i+ 4<= size; i+= 4){
+        __m256d dx= _mm256_sub_pd( _mm256_loadu_pd( x+ i), ox);
+        __m256d dy= _mm256_sub_pd( _mm256_loadu_pd( y+ i), oy);
+        acc= _mm256_max_pd( acc, _mm256_add_pd( _mm256_mul_pd( dx, dx), _mm256_mul_pd( dy, dy)));
+      }
+      max= HorizontalMax( acc);
+#elif defined( __SSE2__)
+      const __m128d ox= _mm_set1_pd( origin_x);
+      const __m128d oy= _mm_set1_pd( origin_y);
+      __m128d acc= _mm_setzero_pd();
+      for( ; i+ 2<= size; i+= 2){
+        __m128d dx= _mm_sub_pd( _mm_loadu_pd( x+ i), ox);
+        __m128d dy= _mm_sub_pd( _mm_loadu_pd( y+ i), oy);
+        acc= _mm_max_pd( acc, _mm_add_pd( _mm_mul_pd( dx, dx), _mm_mul_pd( dy, dy)));
+      }
+      max= HorizontalMax( acc);
+#endif
+      for( ; i< size; i++){
+        double dx= x[ i]- origin_x;
+        double dy= y[ i]- origin_y;
+        max= std::max( max, dx* dx+ dy* dy);
+      }
+      return sqrt( max);
+    }
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef __MCIH_GEOMETRY_H_
+#define __MCIH_GEOMETRY_H_
+
+#include <stddef.h>
+
+namespace ns3{
+  namespace mcih{
+    /*
+     * kernels over contiguous coordinate columns of the neighbor table.
+     * vectorized with AVX or SSE2 when the compiler targets them, scalar otherwise.
+     */
+    double GetColumnSum( const double *value, size_t size);
+    // max |( x[ i], y[ i])- ( origin_x, origin_y)|
+    double GetColumnMaxDistance( const double *x, const double *y, size_t size, double origin_x, double origin_y);
+  }
+}
+
+#endif // __MCIH_GEOMETRY_H_
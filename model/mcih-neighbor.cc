@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "ns3/log.h"
 
 #include "mcih-neighbor.h"
@@ -7,110 +9,474 @@ using namespace std;
 namespace ns3{
   NS_LOG_COMPONENT_DEFINE ("McihNeighbors");
   namespace mcih{
-    void Neighbors::Print(){
-      for_each( neighbor.begin(), neighbor.end(), [ &]( auto factor){
-          NS_LOG_LOGIC( "IP:"<< factor.neighbor_address<<
-            "Mac: "<< factor.hardware_address<< ", "<< 
-            "Exp: "<< factor.expire_time<< ", "<< 
-            "Pos: ("<< factor.position.x<< ", "<< factor.position.y<< "), "<< 
-            "Vel: ("<< factor.velocity.x<< ", "<< factor.velocity.y<< "), "<< 
-            "Stt: "<< factor.state<< ", "<< 
-            "Cls: "<< (factor.close?"T":"F")
-            );
-          });
-    }
-    Neighbors::Neighbors( Time delay): neighbor_timer(Timer::CANCEL_ON_DESTROY){
+    NeighborStore::NeighborStore( Time delay): neighbor_timer(Timer::CANCEL_ON_DESTROY), live( 0), node_columns( 0), sum_position_x( 0), sum_position_y( 0), sum_age( 0){
       NS_LOG_FUNCTION( this);
       neighbor_timer.SetDelay( delay);
-      neighbor_timer.SetFunction( &Neighbors::Purge, this);
-      tx_error_callback= MakeCallback( &Neighbors::ProcessTxError, this);
+      neighbor_timer.SetFunction( &NeighborStore::Purge, this);
+      tx_error_callback= MakeCallback( &NeighborStore::ProcessTxError, this);
       NS_LOG_LOGIC( Utility::Coloring( CYAN, "tx callback is set"));
     }
-    Neighbors::~Neighbors(){
-      NS_LOG_FUNCTION( Utility::Coloring( RED, "not implement yet"));
+    NeighborStore::~NeighborStore(){
+      NS_LOG_FUNCTION( this);
     }
-    Time Neighbors::GetExpireTime( Ipv6Address addr){
-      NS_LOG_FUNCTION( this<< addr);
-      Purge();
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); itr++){
-        if( itr->neighbor_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "got expire time")<< itr->expire_time- Simulator::Now());
-          return ( itr->expire_time- Simulator::Now());
+
+    NeighborStore::Neighbor* NeighborStore::Find( View view, Ipv6Address addr){
+      // the neighbor nodes view is keyed by the link local source, the others by the global address
+      uint32_t slot= view== NODE? link_local_index.Find( addr): address_index.Find( addr);
+      if( slot== address_index.NPOS|| !( neighbor[ slot].views& Bit( view))) return 0;
+      return &neighbor[ slot];
+    }
+
+    NeighborStore::Neighbor& NeighborStore::Join( View view, Ipv6Address addr, Time expire_time){
+      uint32_t slot= view== NODE? link_local_index.Find( addr): address_index.Find( addr);
+      if( slot== address_index.NPOS){
+        NS_LOG_LOGIC( "open link to " << addr);
+        slot= Insert();
+        if( view== NODE){
+          SetLinkLocalAddress( slot, addr);
+        } else{
+          SetAddress( slot, addr);
         }
       }
-      NS_LOG_LOGIC( Utility::Coloring( CYAN, "expire time is not found, and return 0"));
-      return Seconds( 0);
+      Refresh( slot, Bit( view), expire_time);
+      return neighbor[ slot];
     }
-    bool Neighbors::IsNeighbor( Ipv6Address addr){
-      NS_LOG_FUNCTION( this<< addr);
-      Purge();
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); itr++){
-        if( itr->neighbor_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "is in neighbor list"));
-          return true;
+
+    NeighborStore::Neighbor& NeighborStore::Update( Ipv6Address link_local_address, Time expire, HelloHeader header){
+      NS_LOG_FUNCTION( this<< link_local_address<< expire);
+      // a hello carries both keys of the sender, records found under either of them are joined
+      Ipv6Address addr= header.GetAddress();
+      uint32_t local_slot= link_local_index.Find( link_local_address);
+      uint32_t global_slot= address_index.Find( addr);
+      uint32_t slot;
+      if( local_slot== address_index.NPOS&& global_slot== address_index.NPOS){
+        NS_LOG_LOGIC( "open link to " << link_local_address);
+        slot= Insert();
+      } else if( local_slot== address_index.NPOS){
+        slot= global_slot;
+      } else if( global_slot== address_index.NPOS|| global_slot== local_slot){
+        slot= local_slot;
+      } else{
+        slot= Merge( local_slot, global_slot);
+      }
+      SetLinkLocalAddress( slot, link_local_address);
+      SetAddress( slot, addr);
+
+      Neighbor &entry= neighbor[ slot];
+      SetGeometry( entry, header.GetPosition(), header.GetVelocity());
+      SetRpm( entry, header.GetRelativePositionAndMobility());
+      entry.role= header.GetRole();
+
+      // registered members are only refreshed, heads join the neighbor headers view
+      uint8_t mask= Bit( NODE)| ( entry.views& Bit( MEMBER));
+      if( entry.role== MasterClusterHead|| entry.role== SubClusterHead) mask|= Bit( HEADER);
+      Refresh( slot, mask, expire+ Simulator::Now());
+      return entry;
+    }
+
+    void NeighborStore::Touch( Neighbor &entry, Time expire){
+      Refresh( ToSlot( entry), entry.views, expire+ Simulator::Now());
+    }
+
+    void NeighborStore::Leave( Neighbor &entry, View view){
+      uint32_t slot= ToSlot( entry);
+      if( !( entry.views& Bit( view))) return;
+      RemoveView( slot, view);
+      if( !entry.views){
+        Erase( slot);
+      } else{
+        UpdateDeadline( slot);
+      }
+    }
+
+    void NeighborStore::ClearView( View view){
+      NS_LOG_FUNCTION( this<< view);
+      while( !views[ view].slots.empty()) Leave( neighbor[ views[ view].slots.back()], view);
+    }
+
+    uint32_t NeighborStore::Insert(){
+      uint32_t slot;
+      if( free_slots.empty()){
+        slot= neighbor.Push( Neighbor());
+        occupied.push_back( true);
+      } else{
+        slot= free_slots.back();
+        free_slots.pop_back();
+        neighbor[ slot]= Neighbor();
+        occupied[ slot]= true;
+      }
+      neighbor[ slot].slot= slot;
+      if( slot_column.size()< neighbor.Size()) slot_column.resize( neighbor.Size());
+      slot_column[ slot]= column_slot.size();
+      column_slot.push_back( slot);
+      position_x.push_back( 0);
+      position_y.push_back( 0);
+      velocity_x.push_back( 0);
+      velocity_y.push_back( 0);
+      speed.push_back( 0);
+      live++;
+      return slot;
+    }
+
+    void NeighborStore::Erase( uint32_t slot){
+      NS_ASSERT( occupied[ slot]);
+      Neighbor &entry= neighbor[ slot];
+      NS_ASSERT( !entry.views);
+      if( address_index.Find( entry.neighbor_address)== slot) address_index.Erase( entry.neighbor_address);
+      if( link_local_index.Find( entry.link_local_address)== slot) link_local_index.Erase( entry.link_local_address);
+      if( hardware_index.Find( entry.hardware_address)== slot) hardware_index.Erase( entry.hardware_address);
+      SwapColumns( slot_column[ slot], column_slot.size()- 1);
+      position_x.pop_back();
+      position_y.pop_back();
+      velocity_x.pop_back();
+      velocity_y.pop_back();
+      speed.pop_back();
+      column_slot.pop_back();
+      occupied[ slot]= false;
+      free_slots.push_back( slot);
+      live--;
+    }
+
+    uint32_t NeighborStore::Merge( uint32_t slot, uint32_t other){
+      // moves the views of other into slot and drops other
+      Neighbor &from= neighbor[ other];
+      for( int view= 0; view< VIEWS; view++){
+        if( !( from.views& Bit( View( view)))) continue;
+        Time expire_time= from.view_expire_time[ view];
+        if( view== HEADER){
+          neighbor[ slot].state= from.state;
+          neighbor[ slot].rsm= from.rsm;
+        }
+        RemoveView( other, View( view));
+        if( neighbor[ slot].views& Bit( View( view))){
+          if( neighbor[ slot].view_expire_time[ view]< expire_time) neighbor[ slot].view_expire_time[ view]= expire_time;
+        } else{
+          AddView( slot, View( view), expire_time);
         }
       }
-      NS_LOG_LOGIC( Utility::Coloring( CYAN, "is not in neighbor list"));
-      return false;
+      Erase( other);
+      UpdateDeadline( slot);
+      return slot;
     }
-    void Neighbors::SetCallback( Callback<void, Ipv6Address> cb){
-      NS_LOG_FUNCTION( this);
-      handle_link_failure = cb;
+
+    void NeighborStore::SetAddress( uint32_t slot, Ipv6Address addr){
+      Neighbor &entry= neighbor[ slot];
+      if( entry.neighbor_address== addr) return;
+      if( address_index.Find( entry.neighbor_address)== slot) address_index.Erase( entry.neighbor_address);
+      entry.neighbor_address= addr;
+      address_index.Insert( addr, slot);
+      if( entry.hardware_address== Mac48Address()) ResolveHardwareAddress( entry);
     }
-    void Neighbors::ProcessTxError( WifiMacHeader const &hdr){
-      NS_LOG_FUNCTION(this);
-      Mac48Address addr = hdr.GetAddr1();
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-        if( itr->hardware_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "tx error node is found"));
-          itr->close= true;
+
+    void NeighborStore::SetLinkLocalAddress( uint32_t slot, Ipv6Address link_local_address){
+      Neighbor &entry= neighbor[ slot];
+      if( entry.link_local_address== link_local_address) return;
+      if( link_local_index.Find( entry.link_local_address)== slot) link_local_index.Erase( entry.link_local_address);
+      entry.link_local_address= link_local_address;
+      link_local_index.Insert( link_local_address, slot);
+      if( entry.hardware_address== Mac48Address()) ResolveHardwareAddress( entry);
+    }
+
+    void NeighborStore::Refresh( uint32_t slot, uint8_t mask, Time expire_time){
+      Neighbor &entry= neighbor[ slot];
+      if( entry.hardware_address== Mac48Address()) ResolveHardwareAddress( entry);
+      for( int view= 0; view< VIEWS; view++){
+        if( !( mask& Bit( View( view)))) continue;
+        if( !( entry.views& Bit( View( view)))){
+          AddView( slot, View( view), expire_time);
+        } else if( entry.view_expire_time[ view]< expire_time){
+          entry.view_expire_time[ view]= expire_time;
         }
       }
+      UpdateDeadline( slot);
+    }
+
+    void NeighborStore::AddView( uint32_t slot, View view, Time expire_time){
+      Neighbor &entry= neighbor[ slot];
+      ViewState &state= views[ view];
+      entry.views|= Bit( view);
+      entry.view_expire_time[ view]= expire_time;
+      entry.view_position[ view]= state.slots.size();
+      state.slots.push_back( slot);
+      state.rpm_index.insert( make_pair( RpmKey( entry.rpm), slot));
+      state.generation++;
+      if( view== NODE){
+        uint32_t column= slot_column[ slot];
+        SwapColumns( column, node_columns);
+        node_columns++;
+        column= slot_column[ slot];
+        InsertSpeed( speed[ column], slot);
+        sum_position_x+= position_x[ column];
+        sum_position_y+= position_y[ column];
+        AgeSum();
+      }
+    }
+
+    void NeighborStore::RemoveView( uint32_t slot, View view){
+      Neighbor &entry= neighbor[ slot];
+      ViewState &state= views[ view];
+      NS_ASSERT( entry.views& Bit( view));
+      uint32_t position= entry.view_position[ view];
+      state.slots[ position]= state.slots.back();
+      neighbor[ state.slots[ position]].view_position[ view]= position;
+      state.slots.pop_back();
+      state.rpm_index.erase( make_pair( RpmKey( entry.rpm), slot));
+      state.generation++;
+      entry.views&= ~Bit( view);
+      if( view== NODE){
+        uint32_t column= slot_column[ slot];
+        EraseSpeed( speed[ column], slot);
+        sum_position_x-= position_x[ column];
+        sum_position_y-= position_y[ column];
+        node_columns--;
+        SwapColumns( column, node_columns);
+        AgeSum();
+      }
+    }
+
+    void NeighborStore::SwapColumns( uint32_t column, uint32_t other){
+      if( column== other) return;
+      std::swap( position_x[ column], position_x[ other]);
+      std::swap( position_y[ column], position_y[ other]);
+      std::swap( velocity_x[ column], velocity_x[ other]);
+      std::swap( velocity_y[ column], velocity_y[ other]);
+      std::swap( speed[ column], speed[ other]);
+      std::swap( column_slot[ column], column_slot[ other]);
+      slot_column[ column_slot[ column]]= column;
+      slot_column[ column_slot[ other]]= other;
+    }
+
+    void NeighborStore::SetGeometry( Neighbor &entry, Vector position, Vector velocity){
+      uint32_t slot= ToSlot( entry);
+      uint32_t column= slot_column[ slot];
+      bool node= entry.views& Bit( NODE);
+      if( node){
+        sum_position_x+= position.x- position_x[ column];
+        sum_position_y+= position.y- position_y[ column];
+      }
+      position_x[ column]= position.x;
+      position_y[ column]= position.y;
+      velocity_x[ column]= velocity.x;
+      velocity_y[ column]= velocity.y;
+      double new_speed= GetScalar( Vector( velocity.x, velocity.y, 0));
+      if( new_speed!= speed[ column]){
+        if( node) EraseSpeed( speed[ column], slot);
+        speed[ column]= new_speed;
+        if( node) InsertSpeed( new_speed, slot);
+      }
+      for( int view= 0; view< VIEWS; view++){
+        if( entry.views& Bit( View( view))) views[ view].generation++;
+      }
+      if( node) AgeSum();
+    }
+
+    void NeighborStore::SetRpm( Neighbor &entry, RPM rpm){
+      if( rpm== entry.rpm) return;
+      uint32_t slot= ToSlot( entry);
+      for( int view= 0; view< VIEWS; view++){
+        if( entry.views& Bit( View( view))) views[ view].rpm_index.erase( make_pair( RpmKey( entry.rpm), slot));
+      }
+      entry.rpm= rpm;
+      for( int view= 0; view< VIEWS; view++){
+        if( entry.views& Bit( View( view))) views[ view].rpm_index.insert( make_pair( RpmKey( rpm), slot));
+      }
+    }
+
+    void NeighborStore::AgeSum(){
+      // running sums drift by rounding, so they are summed again from the columns once in a while
+      if( !node_columns){
+        sum_position_x= 0;
+        sum_position_y= 0;
+        sum_age= 0;
+      } else if( ++sum_age>= 4096){
+        sum_position_x= GetColumnSum( position_x.data(), node_columns);
+        sum_position_y= GetColumnSum( position_y.data(), node_columns);
+        sum_age= 0;
+      }
+    }
+
+    void NeighborStore::InsertSpeed( double value, uint32_t slot){
+      std::pair< double, uint32_t> key( value, slot);
+      speed_order.insert( std::lower_bound( speed_order.begin(), speed_order.end(), key), key);
+    }
+
+    void NeighborStore::EraseSpeed( double value, uint32_t slot){
+      std::pair< double, uint32_t> key( value, slot);
+      std::vector< std::pair< double, uint32_t> >::iterator it= std::lower_bound( speed_order.begin(), speed_order.end(), key);
+      NS_ASSERT( it!= speed_order.end()&& *it== key);
+      speed_order.erase( it);
+    }
+
+    size_t NeighborStore::GetSpeedOrder( double value) const{
+      return std::lower_bound( speed_order.begin(), speed_order.end(), std::make_pair( value, uint32_t( 0)))- speed_order.begin();
+    }
+
+    double NeighborStore::GetSpeed( size_t order, double own_speed, size_t own_order) const{
+      // order-th smallest of the neighbor speeds merged with own speed placed at own_order
+      if( order== own_order) return own_speed;
+      return speed_order[ order< own_order? order: order- 1].first;
+    }
+
+    void NeighborStore::ResolveHardwareAddress( Neighbor &entry){
+      // the ndisc caches are asked only until the address resolves, later the cached one is used
+      Mac48Address hardware_address;
+      if( entry.link_local_address!= Ipv6Address()) hardware_address= LookupMacAddress( entry.link_local_address);
+      if( hardware_address== Mac48Address()&& entry.neighbor_address!= Ipv6Address()) hardware_address= LookupMacAddress( entry.neighbor_address);
+      if( hardware_address== Mac48Address()) return;
+      entry.hardware_address= hardware_address;
+      hardware_index.Insert( hardware_address, ToSlot( entry));
+    }
+
+    void NeighborStore::ProcessTxError( WifiMacHeader const &hdr){
+      NS_LOG_FUNCTION(this);
+      // a tx error closes the link, that is the neighbor nodes view of the record
+      uint32_t slot= hardware_index.Find( hdr.GetAddr1());
+      if( slot== hardware_index.NPOS|| !( neighbor[ slot].views& Bit( NODE))) return;
+      NS_LOG_LOGIC( Utility::Coloring( CYAN, "tx error node is found"));
+      neighbor[ slot].close= true;
+      closed.push_back( slot);
       Purge ();
     }
 
+    void NeighborStore::UpdateDeadline( uint32_t slot){
+      Neighbor &entry= neighbor[ slot];
+      Time expire_time;
+      bool first= true;
+      for( int view= 0; view< VIEWS; view++){
+        if( !( entry.views& Bit( View( view)))) continue;
+        if( first|| entry.view_expire_time[ view]< expire_time) expire_time= entry.view_expire_time[ view];
+        first= false;
+      }
+      if( first|| expire_time== entry.expire_time) return;
+      entry.expire_time= expire_time;
+      PushDeadline( slot);
+    }
 
-    void Neighbors::Purge(){
+    void NeighborStore::PushDeadline( uint32_t slot){
+      // records left behind by refreshed or erased entries are dropped when they reach the top,
+      // the heap is rebuilt once they outnumber the live entries.
+      if( deadlines.size()> 4* live+ 16){
+        std::vector< Deadline> records;
+        for( uint32_t index= 0; index< neighbor.Size(); index++){
+          if( occupied[ index]) records.push_back( Deadline( neighbor[ index].expire_time, index));
+        }
+        deadlines= DeadlineQueue( std::greater< Deadline>(), std::move( records));
+      } else{
+        deadlines.push( Deadline( neighbor[ slot].expire_time, slot));
+      }
+      ScheduleTimer();
+    }
+
+    void NeighborStore::Clear(){
+      neighbor.Clear();
+      occupied.clear();
+      free_slots.clear();
+      address_index.Clear();
+      link_local_index.Clear();
+      hardware_index.Clear();
+      position_x.clear();
+      position_y.clear();
+      velocity_x.clear();
+      velocity_y.clear();
+      speed.clear();
+      column_slot.clear();
+      slot_column.clear();
+      node_columns= 0;
+      speed_order.clear();
+      sum_position_x= 0;
+      sum_position_y= 0;
+      sum_age= 0;
+      for( int view= 0; view< VIEWS; view++){
+        views[ view].slots.clear();
+        views[ view].rpm_index.clear();
+        views[ view].generation++;
+      }
+      deadlines= DeadlineQueue();
+      closed.clear();
+      live= 0;
+      neighbor_timer.Cancel();
+    }
+
+    void NeighborStore::Purge(){
       // NS_LOG_FUNCTION( this);
-      if( neighbor.empty()){
+      if( !live){
         NS_LOG_LOGIC( Utility::Coloring( CYAN, "neighbor list is empty"));
+        deadlines= DeadlineQueue();
+        closed.clear();
+        neighbor_timer.Cancel();
+        return;
+      }
+
+      // only records whose deadline has passed or which were closed by a tx error are visited
+      std::vector< uint32_t> expired;
+      expired.swap( closed);
+      Time now= Simulator::Now();
+      while( !deadlines.empty()&& deadlines.top().expire_time< now){
+        Deadline top= deadlines.top();
+        deadlines.pop();
+        if( occupied[ top.slot]&& neighbor[ top.slot].expire_time== top.expire_time) expired.push_back( top.slot);
+      }
+      if( expired.empty()){
+        ScheduleTimer();
         return;
       }
 
-      CloseNeighbor pred;
-      if( !handle_link_failure.IsNull()){
-        NS_LOG_LOGIC("handle link failer is not null");
-        for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-          if( pred( *itr)){
-            NS_LOG_LOGIC("close link to "<< itr->neighbor_address);
-            handle_link_failure( itr->neighbor_address);
+      // a record may be both closed and due, it is visited once
+      std::sort( expired.begin(), expired.end());
+      expired.erase( std::unique( expired.begin(), expired.end()), expired.end());
+
+      std::vector< LinkFailure> failures[ VIEWS];
+      for( auto itr= expired.begin(); itr!= expired.end(); itr++){
+        uint32_t slot= *itr;
+        if( !occupied[ slot]) continue;
+        Neighbor &entry= neighbor[ slot];
+        for( int view= 0; view< VIEWS; view++){
+          if( !( entry.views& Bit( View( view)))) continue;
+          if( entry.view_expire_time[ view]< now|| ( view== NODE&& entry.close)){
+            NS_LOG_LOGIC("close link to "<< GetAddress( View( view), entry));
+            failures[ view].push_back( LinkFailure( GetAddress( View( view), entry), Role( entry.role)));
+            RemoveView( slot, View( view));
           }
         }
+        entry.close= false;
+        if( !entry.views){
+          Erase( slot);
+        } else{
+          UpdateDeadline( slot);
+        }
       }
+      ScheduleTimer();
 
-      // NS_LOG_LOGIC( Utility::Coloring( CYAN, "delete close neighbor"));
-      neighbor.erase( remove_if( neighbor.begin(), neighbor.end(), pred), neighbor.end());
-      neighbor_timer.Cancel();
-      neighbor_timer.Schedule();
+      // handlers run once the store is consistent, and may query or update it
+      for( int view= 0; view< VIEWS; view++){
+        if( failures[ view].empty()|| views[ view].handle_link_failure.IsNull()) continue;
+        views[ view].handle_link_failure( failures[ view]);
+      }
     }
 
-    void Neighbors::ScheduleTimer(){
-      NS_LOG_FUNCTION( this);
+    void NeighborStore::ScheduleTimer(){
+      // single timer armed for the earliest deadline, left alone when it already fires no later than that
+      if( deadlines.empty()){
+        neighbor_timer.Cancel();
+        return;
+      }
+      Time deadline= deadlines.top().expire_time;
+      if( neighbor_timer.IsRunning()&& Simulator::Now()+ neighbor_timer.GetDelayLeft()<= deadline+ NanoSeconds( 1)) return;
       neighbor_timer.Cancel();
-      neighbor_timer.Schedule();
+      neighbor_timer.Schedule( deadline- Simulator::Now()+ NanoSeconds( 1));
     }
 
-    void Neighbors::AddNdiscCache( Ptr< NdiscCache> ndisc){
+    void NeighborStore::AddNdiscCache( Ptr< NdiscCache> ndisc){
       NS_LOG_FUNCTION( this);
       ndisc_vector.push_back( ndisc);
     }
 
-    void Neighbors::DelNdiscCache(Ptr< NdiscCache> ndisc){
+    void NeighborStore::DelNdiscCache(Ptr< NdiscCache> ndisc){
       NS_LOG_FUNCTION( this);
       ndisc_vector.erase( remove( ndisc_vector.begin(), ndisc_vector.end(), ndisc), ndisc_vector.end());
     }
 
-    Mac48Address Neighbors::LookupMacAddress( Ipv6Address addr){
+    Mac48Address NeighborStore::LookupMacAddress( Ipv6Address addr){
       NS_LOG_FUNCTION( this);
       Mac48Address hwaddr;
       for( auto itr= ndisc_vector.begin(); itr!= ndisc_vector.end(); ++itr){
@@ -133,78 +499,115 @@ namespace ns3{
       return hwaddr;
     }
 
+    const NeighborStore::Neighbor* NeighborStore::GetHighestRpmNeighbor( View view) const{
+      const std::set< std::pair< RPM, uint32_t> > &rpm_index= views[ view].rpm_index;
+      if( rpm_index.empty()) return 0;
+      // the first entry in slot order among the highest rpm
+      auto max_entry= rpm_index.lower_bound( make_pair( rpm_index.rbegin()->first, 0u));
+      return &neighbor[ max_entry->second];
+    }
+
+    const NeighborStore::Neighbor* NeighborStore::GetLowestRpmNeighbor( View view) const{
+      const std::set< std::pair< RPM, uint32_t> > &rpm_index= views[ view].rpm_index;
+      if( rpm_index.empty()) return 0;
+      return &neighbor[ rpm_index.begin()->second];
+    }
+
+    void Neighbors::Print(){
+      ForEach( [ &]( const Neighbor &factor){
+          NS_LOG_LOGIC( "IP:"<< store.GetAddress( view, factor)<<
+            "Mac: "<< factor.hardware_address<< ", "<<
+            "Exp: "<< factor.view_expire_time[ view]<< ", "<<
+            "Pos: ("<< store.GetPosition( factor).x<< ", "<< store.GetPosition( factor).y<< "), "<<
+            "Vel: ("<< store.GetVelocity( factor).x<< ", "<< store.GetVelocity( factor).y<< "), "<<
+            "Stt: "<< ( int)factor.state<< ", "<<
+            "Cls: "<< (factor.close?"T":"F")
+            );
+          });
+    }
+    Neighbors::Neighbors( NeighborStore &store, NeighborStore::View view): store( store), view( view){
+      NS_LOG_FUNCTION( this);
+    }
+    Neighbors::~Neighbors(){
+      NS_LOG_FUNCTION( this);
+      store.ClearView( view);
+    }
+    Time Neighbors::GetExpireTime( Ipv6Address addr){
+      NS_LOG_FUNCTION( this<< addr);
+      Purge();
+      auto entry= Find( addr);
+      if( entry){
+        NS_LOG_LOGIC( Utility::Coloring( CYAN, "got expire time")<< entry->view_expire_time[ view]- Simulator::Now());
+        return ( entry->view_expire_time[ view]- Simulator::Now());
+      }
+      NS_LOG_LOGIC( Utility::Coloring( CYAN, "expire time is not found, and return 0"));
+      return Seconds( 0);
+    }
+    bool Neighbors::IsNeighbor( Ipv6Address addr){
+      NS_LOG_FUNCTION( this<< addr);
+      Purge();
+      if( Find( addr)){
+        NS_LOG_LOGIC( Utility::Coloring( CYAN, "is in neighbor list"));
+        return true;
+      }
+      NS_LOG_LOGIC( Utility::Coloring( CYAN, "is not in neighbor list"));
+      return false;
+    }
+
     Ipv6Address Neighbors::GetHighestRpmNeighborAddress(){
       Purge();
-      if( !neighbor.size()){
+      auto max_entry= store.GetHighestRpmNeighbor( view);
+      if( !max_entry){
         NS_LOG_FUNCTION( Utility::Coloring( RED, "neighbor list is empty"));
         return Ipv6Address();
       }
-      auto max_itr= neighbor.begin();
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); itr++){
-        if( max_itr->rpm< itr->rpm){
-          max_itr= itr;
-        }
-      }
-      return max_itr->neighbor_address;
+      return store.GetAddress( view, *max_entry);
     }
 
     Ipv6Address Neighbors::GetLowestRpmNeighborAddress(){
       // NS_LOG_FUNCTION( this);
       Purge();
-      if( !neighbor.size()){
+      auto min_entry= store.GetLowestRpmNeighbor( view);
+      if( !min_entry){
         NS_LOG_FUNCTION( Utility::Coloring( RED, "neighbor list is empty"));
         return Ipv6Address();
       }
-      auto min_itr= neighbor.begin();
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); itr++){
-        if( min_itr->rpm> itr->rpm){
-          min_itr= itr;
-        }
-      }
-      return min_itr->neighbor_address;
+      return store.GetAddress( view, *min_entry);
     }
 
     bool Neighbors::DelEntry( Ipv6Address addr){
       NS_LOG_FUNCTION( this<< addr);
       Purge();
-      auto itr= find( neighbor.begin(), neighbor.end(), addr);
-      if( itr== neighbor.end()){
+      auto entry= Find( addr);
+      if( !entry){
         NS_LOG_LOGIC( "target entry is not found in list");
         return false;
       }
-      neighbor.erase(itr);
+      store.Leave( *entry, view);
       Purge();
       return true;
     }
 
     double NeighborNodes::GetRelativePositionAndMobility( double alpha, Vector position, Vector velocity) const{
-      if( !neighbor.size()) return 1;
-      Vector center_position( GetCenterPosition( position));
-      vector< double> scalar_velocity( GetScalarVelocity( velocity));
-
-      // velocity vector and center position
-      for_each( neighbor.begin(), neighbor.end(), [ &]( auto factor){
-          NS_LOG_LOGIC( string( Utility::Coloring( CYAN, "position " ))<< factor.position.x<< ", "<< factor.position.y<< ", "<< factor.position.z<< ", "
-            << string( Utility::Coloring( CYAN, "velocity "))<< factor.velocity.x<< ", "<< factor.velocity.y<< ", "<< factor.velocity.z<< " -> "<< GetScalar( factor.velocity)<< ", "
-            << string( Utility::Coloring( CYAN, "address "))<< factor.neighbor_address<< ", "
-            << string( Utility::Coloring( CYAN, "rpm "))<< factor.rpm<< ", "
-            << string( Utility::Coloring( CYAN, "time "))<< ( factor.expire_time- Simulator::Now()).As( Time::Unit::MS));
-          });
-      sort( scalar_velocity.begin(), scalar_velocity.end());
-      double median_velocity= GetMedian( scalar_velocity);
-
-      vector< double> relative_distance;
-      vector< double> relative_speed;
-      relative_distance.push_back( GetScalar( GetDistance( center_position, position)));
-      relative_speed.push_back( abs( median_velocity- GetScalar( velocity)));
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); itr++){
-        relative_distance.push_back( GetScalar( GetDistance( center_position, itr->position)));
-        relative_speed.push_back( abs( median_velocity- GetScalar( itr->velocity)));
-      }
-      double max_relative_distance= *max_element( relative_distance.begin(), relative_distance.end());
-      double max_relative_speed= *max_element( relative_speed.begin(), relative_speed.end());
+      size_t live= store.node_columns;
+      if( !live) return 1;
+      Vector center_position( 0, 0, 0);
+      center_position.x= ( position.x+ store.sum_position_x)/ ( live+ 1);
+      center_position.y= ( position.y+ store.sum_position_y)/ ( live+ 1);
+
+      // median, min and max of the neighbor speeds together with own speed, read from the sorted speeds
+      double own_speed= GetScalar( velocity);
+      size_t own_order= store.GetSpeedOrder( own_speed);
+      size_t size= live+ 1;
+      double median_velocity= store.GetSpeed( size/ 2, own_speed, own_order);
+      if( !( size% 2)) median_velocity= ( store.GetSpeed( size/ 2- 1, own_speed, own_order)+ median_velocity)/ 2;
+      double min_velocity= std::min( own_speed, store.speed_order.front().first);
+      double max_velocity= std::max( own_speed, store.speed_order.back().first);
+
       double relative_distance_1c= GetScalar( GetDistance( center_position, position));
-      double relative_speed_1c= abs( median_velocity- GetScalar( velocity));
+      double relative_speed_1c= abs( median_velocity- own_speed);
+      double max_relative_distance= std::max( relative_distance_1c, GetColumnMaxDistance( store.position_x.data(), store.position_y.data(), live, center_position.x, center_position.y));
+      double max_relative_speed= std::max( median_velocity- min_velocity, max_velocity- median_velocity);
 
       RPM rpm= alpha*(relative_distance_1c/max_relative_distance)+ ( 1- alpha)* ( relative_speed_1c/ max_relative_speed);
       NS_LOG_LOGIC( Utility::Coloring( CYAN, "RPM") <<": "<< rpm<< "="<< alpha<< "("<< relative_distance_1c<< "/"<< max_relative_distance<< ")+(1-"<< alpha<< ")"<< relative_speed_1c<< "/"<< max_relative_speed);
@@ -214,64 +617,21 @@ namespace ns3{
 
     void NeighborNodes::Update( Ipv6Address addr, Time expire, UnadvHeader header){
       NS_LOG_FUNCTION( this<< addr<< expire);
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-        if( itr->neighbor_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "target ip address is found, and updating expire timer"));
-          itr->expire_time= std::max( expire+ Simulator::Now(), itr->expire_time);
-          itr->position= header.GetPosition();
-          itr->velocity= header.GetVelocity();
-          itr->rpm= header.GetRelativePositionAndMobility();
-          itr->role= Undecided;
-          // if (itr->hardware_address== Mac48Address()){
-          //   NS_LOG_LOGIC( Utility::Coloring( CYAN, "updating mac address is necessary"));
-          //   itr->hardware_address= LookupMacAddress( itr->neighbor_address);
-          // }
-          return;
-        }
-      }
-      NS_LOG_LOGIC( "open link to " << addr);
-      Neighbor neighbor_instance( addr, LookupMacAddress( addr), expire+ Simulator::Now(), header.GetPosition(), header.GetVelocity(), header.GetRelativePositionAndMobility());
-      neighbor.push_back( neighbor_instance);
+      auto &entry= store.Join( view, addr, expire+ Simulator::Now());
+      store.SetGeometry( entry, header.GetPosition(), header.GetVelocity());
+      store.SetRpm( entry, header.GetRelativePositionAndMobility());
+      entry.role= Undecided;
       Purge();
     }
 
-    void NeighborNodes::Update( Ipv6Address addr, Time expire, HelloHeader header){
-      NS_LOG_FUNCTION( this<< addr<< expire);
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-        if( itr->neighbor_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "target ip address is found, and updating expire timer"));
-          itr->expire_time= std::max( expire+ Simulator::Now(), itr->expire_time);
-          itr->position= header.GetPosition();
-          itr->velocity= header.GetVelocity();
-          itr->rpm= header.GetRelativePositionAndMobility();
-          itr->rsm= header.GetRelativeStateAndMobility();
-          itr->role= header.GetRole();
-          // if (itr->hardware_address== Mac48Address()){
-          //   NS_LOG_LOGIC( Utility::Coloring( CYAN, "updating mac address is necessary"));
-          //   itr->hardware_address= LookupMacAddress( itr->neighbor_address);
-          // }
-          return;
-        }
-      }
-      NS_LOG_LOGIC( "open link to " << addr);
-      Neighbor neighbor_instance( addr, LookupMacAddress( addr), expire+ Simulator::Now(), header.GetPosition(), header.GetVelocity(), header.GetRelativePositionAndMobility(), header.GetRole());
-      neighbor.push_back( neighbor_instance);
-      Purge();
+    double NeighborHeaders::GetRelativeStateAndMobility( double alpha, State state, Vector velocity, const Neighbor &header) const{
+      if( !store.GetSize( view)) return 1;
+      return GetRelativeStateAndMobility( alpha, state, velocity, header, GetBestState(), GetHighestRelativeSpeed( velocity));
     }
 
-    double NeighborHeaders::GetRelativeStateAndMobility( double alpha, State state, Vector velocity, uint32_t ch_index) const{
-      if( !neighbor.size()) return 1;
-
-      State best_state= GetBestState();
+    RSM NeighborHeaders::GetRelativeStateAndMobility( double alpha, State state, Vector velocity, const Neighbor &header, State best_state, double highest_rel_speed) const{
       if( !best_state) return 2;
-      auto highest_rel_speed_vector= GetScalarRelativeVelocity( velocity);
-      sort( highest_rel_speed_vector.begin(), highest_rel_speed_vector.end());
-      auto highest_rel_speed= highest_rel_speed_vector[ highest_rel_speed_vector.size()- 1];
-      double median_velocity= GetMedian( highest_rel_speed_vector);
-      // NS_LOG_LOGIC(  "MEDIAN  "<< median_velocity<< ", MAX "<< highest_rel_speed);
-
-      auto header= neighbor[ch_index];
-      double relative_speed_1c= abs( GetScalar( header.velocity)- GetScalar( velocity));
+      double relative_speed_1c= abs( store.GetSpeed( header)- GetScalar( velocity));
 
       RSM rsm= alpha* ( double)( best_state- state)/ ( double)best_state+ ( 1- alpha)* relative_speed_1c/ highest_rel_speed;
       // NS_LOG_LOGIC( "RSM: "<< rsm<< " = "<< ( double)state/ ( double)best_state<< " + "<< relative_speed_1c/ highest_rel_speed);
@@ -279,104 +639,63 @@ namespace ns3{
       return rsm;
     }
 
-    void NeighborHeaders::Update( Ipv6Address addr, Time expire, MchadvHeader header, Vector now_position, Vector now_velocity){
-      NS_LOG_FUNCTION( this<< addr<< expire);
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-        if( itr->neighbor_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "target ip address is found, and updating expire timer"));
-          itr->expire_time= std::max( expire+ Simulator::Now(), itr->expire_time);
-          itr->position= header.GetPosition();
-          itr->velocity= header.GetVelocity();
-          // itr->rpm= header.GetRelativePositionAndMobility();
-          Vector rel_pos= GetDistance( itr->position, now_position);
-          Vector rel_vel= GetDistance( itr->velocity, now_velocity);
-          // NS_LOG_LOGIC( "TEST "<< rel_pos.x<< ", "<< rel_pos.y);
-          // NS_LOG_LOGIC( "TEST "<< rel_vel.x<< ", "<< rel_vel.y);
-          itr->state= CalcState( rel_pos, rel_vel);
-          itr->rsm= GetRelativeStateAndMobility( 0.5, itr->state, now_velocity, distance( neighbor.begin(), itr));
-          // NS_LOG_LOGIC( "STATE "<< ToString( itr->state));
-          return;
-        }
-
-        for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-          itr->rsm= GetRelativeStateAndMobility( 0.5, itr->state, now_velocity, distance( neighbor.begin(), itr));
-        }
+    void NeighborHeaders::RefreshRsm(){
+      if( !rsm_dirty&& rsm_generation== store.GetGeneration( view)) return;
+      NS_LOG_FUNCTION( this<< store.GetSize( view));
+      if( store.GetSize( view)){
+        State best_state= GetBestState();
+        double highest_rel_speed= GetHighestRelativeSpeed( rsm_velocity);
+        const Neighbor *best= 0;
+        ForEach( [ &]( Neighbor &factor){
+            factor.rsm= GetRelativeStateAndMobility( 0.5, State( factor.state), rsm_velocity, factor, best_state, highest_rel_speed);
+            if( !best|| best->rsm> factor.rsm) best= &factor;
+            });
+        best_rsm_slot= store.ToSlot( *best);
       }
-      NS_LOG_LOGIC( "open link to " << addr);
-      Neighbor neighbor_instance( addr, LookupMacAddress( addr), expire+ Simulator::Now(), header.GetPosition(), header.GetVelocity(), header.GetRelativePositionAndMobility());
-      neighbor.push_back( neighbor_instance);
-      Purge();
+      rsm_dirty= false;
+      rsm_generation= store.GetGeneration( view);
     }
 
-    void NeighborHeaders::Update( Ipv6Address addr, Time expire, HelloHeader header, Vector now_position, Vector now_velocity){
+    void NeighborHeaders::Update( Ipv6Address addr, Time expire, MchadvHeader header, Vector now_position, Vector now_velocity){
       NS_LOG_FUNCTION( this<< addr<< expire);
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-        if( itr->neighbor_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "target ip address is found, and updating expire timer"));
-          itr->expire_time= std::max( expire+ Simulator::Now(), itr->expire_time);
-          itr->position= header.GetPosition();
-          itr->velocity= header.GetVelocity();
-          Vector rel_pos= GetDistance( itr->position, now_position);
-          Vector rel_vel= GetDistance( itr->velocity, now_velocity);
-          itr->state= CalcState( rel_pos, rel_vel);
-          itr->rsm= GetRelativeStateAndMobility( 0.5, itr->state, now_velocity, distance( neighbor.begin(), itr));
-          return;
-        }
-
-        for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-          itr->rsm= GetRelativeStateAndMobility( 0.5, itr->state, now_velocity, distance( neighbor.begin(), itr));
-        }
-      }
-      NS_LOG_LOGIC( "open link to " << addr);
-      Neighbor neighbor_instance( addr, LookupMacAddress( addr), expire+ Simulator::Now(), header.GetPosition(), header.GetVelocity(), header.GetRelativePositionAndMobility());
-      neighbor.push_back( neighbor_instance);
+      auto &entry= store.Join( view, addr, expire+ Simulator::Now());
+      store.SetGeometry( entry, header.GetPosition(), header.GetVelocity());
+      store.SetRpm( entry, header.GetRelativePositionAndMobility());
+      Update( entry, now_position, now_velocity);
       Purge();
     }
 
+    void NeighborHeaders::Update( Neighbor &entry, Vector now_position, Vector now_velocity){
+      // the record has been refreshed by the store, only the state against own mobility is left
+      rsm_dirty= true;
+      rsm_velocity= now_velocity;
+      entry.state= CalcState( GetDistance( store.GetPosition( entry), now_position), GetDistance( store.GetVelocity( entry), now_velocity));
+    }
+
     bool NeighborHeaders::SetOwnClusterHead( Ipv6Address address){
-      auto itr= find( neighbor.begin(), neighbor.end(), Neighbor( address, Mac48Address(), Time()));
-      if( itr== neighbor.end()){
+      RefreshRsm();
+      auto entry= Find( address);
+      if( !entry){
         NS_LOG_FUNCTION( "unknown address"<< address);
         return false;
         //NS_ABORT_MSG( "unknown address");
       }
 
-      own_cluster_head= *itr;
+      own_cluster_head= *entry;
       return true;
     }
 
-    Neighbors::Neighbor NeighborHeaders::GetBestHeader(){
-      Neighbor best= own_cluster_head;
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); itr++){
-        if( best.rsm> itr->rsm) best= *itr;
-      }
-      return best;
+    const Neighbors::Neighbor& NeighborHeaders::GetBestHeader(){
+      RefreshRsm();
+      if( !store.GetSize( view)) return own_cluster_head;
+      if( own_cluster_head.neighbor_address== Ipv6Address()|| own_cluster_head.rsm> store.GetNeighbor( best_rsm_slot).rsm) return store.GetNeighbor( best_rsm_slot);
+      return own_cluster_head;
     }
 
     NS_LOG_COMPONENT_DEFINE ("ClusterMembers");
     void ClusterMembers::Update( Ipv6Address addr, Time expire){
       NS_LOG_FUNCTION( this<< "new entry"<< addr<< expire);
-      NS_LOG_LOGIC( "open link to " << addr);
-      Neighbor neighbor_instance( addr, LookupMacAddress( addr), expire+ Simulator::Now());
-      neighbor.push_back( neighbor_instance);
-      Purge();
-    }
-
-    void ClusterMembers::Update( Ipv6Address addr, Time expire, HelloHeader header){
-      NS_LOG_FUNCTION( this<< addr<< expire);
-      for( auto itr= neighbor.begin(); itr!= neighbor.end(); ++itr){
-        if( itr->neighbor_address== addr){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, "target ip address is found, and updating expire timer"));
-          itr->expire_time= std::max( expire+ Simulator::Now(), itr->expire_time);
-          itr->position= header.GetPosition();
-          itr->velocity= header.GetVelocity();
-          itr->rpm= header.GetRelativePositionAndMobility();
-          itr->role= header.GetRole();
-          NS_LOG_LOGIC( "update entry " << addr);
-          return;
-        }
-      }
-      NS_LOG_LOGIC( "non member " << addr);
+      store.Join( view, addr, expire+ Simulator::Now());
       Purge();
     }
   };
@@ -1,6 +1,12 @@
 #ifndef __MCIH_NEIGHBOR_H_
 #define __MCIH_NEIGHBOR_H_
 
+#include <queue>
+#include <set>
+#include <cmath>
+#include <limits>
+#include <functional>
+
 #include "ns3/simulator.h"
 #include "ns3/timer.h"
 #include "ns3/ipv4-address.h"
@@ -11,47 +17,203 @@
 
 #include "mcih-utility.h"
 #include "mcih-packet.h"
+#include "mcih-slot-index.h"
+#include "mcih-arena.h"
+#include "mcih-geometry.h"
 
 namespace ns3{
   namespace mcih{
     class RoutingProtocol;
-    class Neighbors{
+    struct Mac48AddressHash{
+      size_t operator()( const Mac48Address &address) const{
+        uint8_t buffer[ 6];
+        address.CopyTo( buffer);
+        size_t hash= 0;
+        for( int i= 0; i< 6; i++) hash= hash* 131+ buffer[ i];
+        return hash^ ( hash>> 17);
+      }
+    };
+    /*
+     * one record per neighboring node, shared by the neighbor nodes, neighbor headers and cluster members views.
+     * a record belongs to the views set in its bit mask and has an expire time for each of them,
+     * the deadline queue holds the earliest one only.
+     * geometry is kept in the columns only, planar as DIMENSION is 2, so a record carries addresses, times and metrics.
+     */
+    class NeighborStore{
       public:
+        enum View{ NODE= 0, HEADER= 1, MEMBER= 2, VIEWS= 3};
         enum State{ Far= 0, Depart= 1, Approach= 2, Near= 3};
+        struct Neighbor {
+          Ipv6Address neighbor_address; // global address, Ipv6Address() until it is known
+          Ipv6Address link_local_address; // Ipv6Address() until it is known
+          Time expire_time; // earliest expire time of the views
+          Time view_expire_time[ VIEWS];
+          RPM rpm;
+          RSM rsm;
+          uint32_t view_position[ VIEWS];
+          uint32_t slot;
+          Mac48Address hardware_address;
+          HelloState hello_keyframe; // last keyframe hello, delta hellos of the neighbor are resolved against it
+          uint8_t state; // State
+          uint8_t role; // Role
+          uint8_t views;
+          bool close;
+          bool has_keyframe;
+
+          Neighbor(): rpm( 1), rsm( 1), slot( 0), state( Far), role( Undecided), views( 0), close( false), has_keyframe( false){
+          }
+          bool operator== ( const Neighbor &target ) const{ return target.neighbor_address== neighbor_address; }
+          bool operator== ( const Ipv6Address &target ) const{ return target== neighbor_address; }
+        };
+        // a neighbor that dropped out of a view, delivered in one batch per view and purge
+        struct LinkFailure{
+          Ipv6Address address;
+          Role role; // last known role
+          LinkFailure( Ipv6Address a, Role r): address( a), role( r){
+          }
+        };
+        typedef Callback< void, const std::vector< LinkFailure>& > LinkFailureCallback;
+        static uint8_t Bit( View view){ return 1<< view;}
+        static_assert( DIMENSION== 2, "neighbor geometry columns are planar");
+
+        NeighborStore( Time delay);
+        ~NeighborStore();
+        Neighbor* Find( View view, Ipv6Address addr);
+        Neighbor& Join( View view, Ipv6Address addr, Time expire_time);
+        Neighbor& Update( Ipv6Address link_local_address, Time expire, HelloHeader header);
+        // keeps every view of entry for expire more, for a hello that could not be read
+        void Touch( Neighbor &entry, Time expire);
+        void Leave( Neighbor &entry, View view);
+        void ClearView( View view);
+        void Clear();
+        void Purge();
+        void SetGeometry( Neighbor &entry, Vector position, Vector velocity);
+        void SetRpm( Neighbor &entry, RPM rpm);
+        Vector GetPosition( const Neighbor &entry) const{
+          uint32_t column= slot_column[ entry.slot];
+          return Vector( position_x[ column], position_y[ column], 0);
+        }
+        Vector GetVelocity( const Neighbor &entry) const{
+          uint32_t column= slot_column[ entry.slot];
+          return Vector( velocity_x[ column], velocity_y[ column], 0);
+        }
+        double GetSpeed( const Neighbor &entry) const{ return speed[ slot_column[ entry.slot]];}
+        Ipv6Address GetAddress( View view, const Neighbor &entry) const{ return view== NODE? entry.link_local_address: entry.neighbor_address;}
+        size_t GetSize( View view) const{ return views[ view].slots.size();}
+        uint64_t GetGeneration( View view) const{ return views[ view].generation;}
+        void SetCallback( View view, LinkFailureCallback cb){ views[ view].handle_link_failure= cb;}
+        LinkFailureCallback GetCallBack( View view) const{ return views[ view].handle_link_failure;}
+        void AddNdiscCache( Ptr< NdiscCache> ndisc);
+        void DelNdiscCache( Ptr< NdiscCache> ndisc);
+        std::vector< Ptr< NdiscCache> > GetNdiscCache() const{ return ndisc_vector;}
+        Callback<void, WifiMacHeader const &> GetTxErrorCallback () const { return tx_error_callback; }
+        Mac48Address LookupMacAddress( Ipv6Address);
+        const Neighbor* GetHighestRpmNeighbor( View view) const;
+        const Neighbor* GetLowestRpmNeighbor( View view) const;
+        Neighbor& GetNeighbor( uint32_t slot){ return neighbor[ slot];}
+        uint32_t ToSlot( const Neighbor &entry) const{ return entry.slot;}
+        template< typename Function> void ForEach( View view, Function function){
+          const std::vector< uint32_t> &slots= views[ view].slots;
+          for( size_t i= 0; i< slots.size(); i++) function( neighbor[ slots[ i]]);
+        }
+        template< typename Function> void ForEach( View view, Function function) const{
+          const std::vector< uint32_t> &slots= views[ view].slots;
+          for( size_t i= 0; i< slots.size(); i++) function( neighbor[ slots[ i]]);
+        }
+
+      private:
+        friend class NeighborNodes;
+        Callback<void, WifiMacHeader const &> tx_error_callback;
+        Timer neighbor_timer;
+        std::vector< Ptr< NdiscCache> > ndisc_vector;
+        struct Deadline{
+          Time expire_time;
+          uint32_t slot;
+          Deadline( Time t, uint32_t s): expire_time( t), slot( s){
+          }
+          bool operator> ( const Deadline &target) const{ return expire_time> target.expire_time; }
+        };
+        typedef std::priority_queue< Deadline, std::vector< Deadline>, std::greater< Deadline> > DeadlineQueue;
+        DeadlineQueue deadlines; // min-heap on expire time, may hold outdated records
+        std::vector< uint32_t> closed;
+        struct ViewState{
+          std::vector< uint32_t> slots; // dense list of the member slots
+          std::set< std::pair< RPM, uint32_t> > rpm_index; // ( rpm, slot) of every member
+          uint64_t generation; // bumped whenever a member joins, leaves or moves
+          LinkFailureCallback handle_link_failure;
+          ViewState(): generation( 0){
+          }
+        };
+        ViewState views[ VIEWS];
+
+        ChunkArena< Neighbor> neighbor; // slot pool, a slot keeps its record until the record is erased
+        std::vector< bool> occupied;
+        std::vector< uint32_t> free_slots;
+        SlotIndex< Ipv6Address, Ipv6AddressHash> address_index;
+        SlotIndex< Ipv6Address, Ipv6AddressHash> link_local_index;
+        SlotIndex< Mac48Address, Mac48AddressHash> hardware_index; // resolved hardware addresses only
+        size_t live;
+        // geometry of the live records in contiguous columns, the neighbor nodes view is kept as the prefix [ 0, node_columns)
+        std::vector< double> position_x;
+        std::vector< double> position_y;
+        std::vector< double> velocity_x;
+        std::vector< double> velocity_y;
+        std::vector< double> speed;
+        std::vector< uint32_t> column_slot;
+        std::vector< uint32_t> slot_column;
+        size_t node_columns;
+        // running position sums and the ( speed, slot) pairs of the neighbor nodes view kept sorted, the rank of a speed is its lower bound
+        std::vector< std::pair< double, uint32_t> > speed_order;
+        double sum_position_x;
+        double sum_position_y;
+        uint32_t sum_age;
+
+        uint32_t Insert();
+        void Erase( uint32_t slot);
+        uint32_t Merge( uint32_t slot, uint32_t other);
+        void SetAddress( uint32_t slot, Ipv6Address addr);
+        void SetLinkLocalAddress( uint32_t slot, Ipv6Address link_local_address);
+        void Refresh( uint32_t slot, uint8_t mask, Time expire_time);
+        void AddView( uint32_t slot, View view, Time expire_time);
+        void RemoveView( uint32_t slot, View view);
+        void UpdateDeadline( uint32_t slot);
+        void PushDeadline( uint32_t slot);
+        void ScheduleTimer();
+        void SwapColumns( uint32_t column, uint32_t other);
+        void ResolveHardwareAddress( Neighbor &entry);
+        void ProcessTxError( WifiMacHeader const &);
+        void AgeSum();
+        void InsertSpeed( double value, uint32_t slot);
+        void EraseSpeed( double value, uint32_t slot);
+        size_t GetSpeedOrder( double value) const;
+        double GetSpeed( size_t order, double own_speed, size_t own_order) const;
+        // nan, from a degenerate neighborhood, would break the set ordering and is indexed as the largest value
+        static RPM RpmKey( RPM rpm){ return std::isnan( rpm)? std::numeric_limits< RPM>::max(): rpm;}
+    };
+
+    /*
+     * role filtered view of the neighbor store.
+     */
+    class Neighbors{
+      public:
+        typedef NeighborStore::State State;
+        typedef NeighborStore::Neighbor Neighbor;
+        typedef NeighborStore::LinkFailure LinkFailure;
         std::string ToString( State state){
           switch( state){
-            case Near:
+            case NeighborStore::Near:
               return "Near";
-            case Approach:
+            case NeighborStore::Approach:
               return "Approach";
-            case Depart:
+            case NeighborStore::Depart:
               return "Depart";
-            case Far:
+            case NeighborStore::Far:
               return "Far";
             default:
               NS_ABORT_MSG( "invalid state");
           }
           return "STATE";
         }
-        struct Neighbor {
-          Ipv6Address neighbor_address;
-          Mac48Address hardware_address;
-          Time expire_time;
-          Vector position;
-          Vector velocity;
-          RPM rpm;
-          RSM rsm;
-          State state;
-          Role role;
-          bool close;
-
-          Neighbor( Ipv6Address ip, Mac48Address mac, Time t, Vector p, Vector v, RPM r, Role role= Undecided): neighbor_address( ip), hardware_address( mac), expire_time( t), position( p), velocity( v), rpm( r), role( role), close( false){
-          }
-          Neighbor( Ipv6Address ip, Mac48Address mac, Time t): neighbor_address( ip), hardware_address( mac), expire_time( t), position( Vector( 0, 0, 0)), velocity( Vector( 0, 0, 0)), rpm( 1), close( false){
-          }
-          bool operator== ( const Neighbor &target ) const{ return target.neighbor_address== neighbor_address; }
-          bool operator== ( const Ipv6Address &target ) const{ return target== neighbor_address; }
-        };
         void Print();
         struct CloseNeighbor {
           bool operator() (const Neighbors::Neighbor & nb) const {
@@ -59,118 +221,98 @@ namespace ns3{
           }
         };
 
-        Neighbors( Time delay);
+        Neighbors( NeighborStore &store, NeighborStore::View view);
         virtual ~Neighbors()= 0;
         Time GetExpireTime( Ipv6Address addr);
         bool IsNeighbor( Ipv6Address addr);
-        void Purge();
-        void ScheduleTimer();
-        void Clear(){ neighbor.clear(); }
-        void AddNdiscCache( Ptr< NdiscCache> ndisc);
-        void DelNdiscCache( Ptr< NdiscCache> ndisc);
-        std::vector< Ptr< NdiscCache> > GetNdiscCache() const{ return ndisc_vector;}
-        Callback<void, WifiMacHeader const &> GetTxErrorCallback () const { return tx_error_callback; }
-        void SetCallback( Callback<void, Ipv6Address> cb);
-        Callback< void, Ipv6Address> GetCallBack() const{ return handle_link_failure;}
-        size_t GetNeighborNumber(){ Purge(); return neighbor.size();};
-        Mac48Address LookupMacAddress( Ipv6Address);
+        void Purge(){ store.Purge();}
+        void Clear(){ store.ClearView( view);}
+        void SetCallback( NeighborStore::LinkFailureCallback cb){ store.SetCallback( view, cb);}
+        NeighborStore::LinkFailureCallback GetCallBack() const{ return store.GetCallBack( view);}
+        size_t GetNeighborNumber(){ store.Purge(); return store.GetSize( view);};
+        uint64_t GetGeneration() const{ return store.GetGeneration( view);}
+        Mac48Address LookupMacAddress( Ipv6Address addr){ return store.LookupMacAddress( addr);}
         Ipv6Address GetHighestRpmNeighborAddress();
         Ipv6Address GetLowestRpmNeighborAddress();
         bool DelEntry( Ipv6Address addr);
-      private:
-        Callback<void, Ipv6Address> handle_link_failure;
-        Callback<void, WifiMacHeader const &> tx_error_callback;
-        Timer neighbor_timer;
-        std::vector< Ptr< NdiscCache> > ndisc_vector;
-        void ProcessTxError( WifiMacHeader const &);
       protected:
-        std::vector< Neighbor> neighbor;
-        State CalcState( Vector rel_pos, Vector rel_vel){
+        NeighborStore &store;
+        NeighborStore::View view;
+        Neighbor* Find( Ipv6Address addr){ return store.Find( view, addr);}
+        template< typename Function> void ForEach( Function function){ store.ForEach( view, function);}
+        template< typename Function> void ForEach( Function function) const{ static_cast< const NeighborStore&>( store).ForEach( view, function);}
+        static State CalcState( Vector rel_pos, Vector rel_vel){
           auto rel_distance= GetEuclidDistance( rel_pos, rel_vel);
           auto rel_pos_scalar= GetScalar( rel_pos);
-          if( rel_distance< 50.0) return Near;
-          if( rel_distance> 100.0) return Far;
+          if( rel_distance< 50.0) return NeighborStore::Near;
+          if( rel_distance> 100.0) return NeighborStore::Far;
           if( rel_distance> rel_pos_scalar){ // depart
-            return Depart;
+            return NeighborStore::Depart;
           } else{ // approach
-            return Approach;
+            return NeighborStore::Approach;
           }
         }
-        Vector GetCenterPosition( Vector position) const{
-          Vector center_position( 0, 0, 0);
-          center_position.x+= position.x;
-          center_position.y+= position.y;
-          center_position.z+= position.z;
-          for_each( neighbor.begin(), neighbor.end(), [ &]( auto factor){
-              center_position.x+= factor.position.x;
-              center_position.y+= factor.position.y;
-              center_position.z+= factor.position.z;
-              });
-          center_position.x/= neighbor.size()+ 1;
-          center_position.y/= neighbor.size()+ 1;
-          center_position.z/= neighbor.size()+ 1;
-          return center_position;
-        }
-        std::vector< double> GetScalarVelocity( Vector velocity) const{
-          std::vector< double> scalar_velocity;
-          scalar_velocity.push_back( GetScalar( velocity));
-          for_each( neighbor.begin(), neighbor.end(), [ &]( auto factor){
-              scalar_velocity.push_back( GetScalar( factor.velocity));
+        double GetHighestRelativeSpeed( Vector velocity) const{
+          double highest= 0;
+          ForEach( [ &]( const Neighbor &factor){
+              highest= std::max( highest, GetScalar( GetDistance( store.GetVelocity( factor), Vector( velocity.x, velocity.y, 0))));
               });
-          return scalar_velocity;
-        }
-        std::vector< double> GetScalarRelativeVelocity( Vector velocity) const{
-          std::vector< double> scalar_velocity;
-          Vector rel_vel( 0, 0, 0);
-          for_each( neighbor.begin(), neighbor.end(), [ &]( auto factor){
-              rel_vel= GetDistance( factor.velocity, velocity);
-              scalar_velocity.push_back( GetScalar( rel_vel));
-              });
-          return scalar_velocity;
+          return highest;
         }
         State GetBestState() const{
-          State state= Far;
-          for_each( neighbor.begin(), neighbor.end(), [ &]( auto factor){
-              if( state< factor.state) state= factor.state;
+          State state= NeighborStore::Far;
+          ForEach( [ &]( const Neighbor &factor){
+              if( state< factor.state) state= State( factor.state);
               });
           return state;
         }
     };
     class NeighborNodes: public Neighbors{
       public:
-        NeighborNodes( Time delay): Neighbors( delay){
+        NeighborNodes( NeighborStore &store): Neighbors( store, NeighborStore::NODE){
         }
         virtual ~NeighborNodes(){
         }
         double GetRelativePositionAndMobility( double alpha, Vector position, Vector velocity) const;
         void Update( Ipv6Address addr, Time expire, UnadvHeader header);
-        void Update( Ipv6Address addr, Time expire, HelloHeader header);
     };
     class NeighborHeaders: public Neighbors{
       public:
-        NeighborHeaders( Time delay): Neighbors( delay), own_cluster_head( Ipv6Address(), Mac48Address(), Time()){
+        NeighborHeaders( NeighborStore &store): Neighbors( store, NeighborStore::HEADER), rsm_dirty( false), rsm_generation( 0), best_rsm_slot( 0){
         }
         virtual ~NeighborHeaders(){
         }
-        double GetRelativeStateAndMobility( double alpha, State state, Vector velocity, uint32_t ch_index) const;
+        double GetRelativeStateAndMobility( double alpha, State state, Vector velocity, const Neighbor &header) const;
         void Update( Ipv6Address addr, Time expire, MchadvHeader header, Vector now_position, Vector now_velocity);
-        void Update( Ipv6Address addr, Time expire, HelloHeader header, Vector now_position, Vector now_velocity);
+        void Update( Neighbor &entry, Vector now_position, Vector now_velocity);
         bool SetOwnClusterHead( Ipv6Address address);
-        Neighbor GetOwnClusterHead(){ return own_cluster_head; }
-        Neighbor GetBestHeader();
+        void ClearOwnClusterHead(){ own_cluster_head= Neighbor();}
+        const Neighbor& GetOwnClusterHead() const{ return own_cluster_head; }
+        const Neighbor& GetBestHeader();
         bool IsOwnClusterHead( Ipv6Address address){ return address== own_cluster_head.neighbor_address;}
+        template< typename Function> void ForEachHeader( Function function){
+          Purge();
+          static_cast< const NeighborHeaders*>( this)->ForEach( function);
+        }
       protected:
         State state;
         Neighbor own_cluster_head;
+      private:
+        // rsm of every entry is recomputed in one pass when it is read after the view changed
+        bool rsm_dirty;
+        uint64_t rsm_generation;
+        uint32_t best_rsm_slot; // first entry with the lowest rsm, valid after RefreshRsm
+        Vector rsm_velocity;
+        void RefreshRsm();
+        RSM GetRelativeStateAndMobility( double alpha, State state, Vector velocity, const Neighbor &header, State best_state, double highest_rel_speed) const;
     };
     class ClusterMembers: public Neighbors{
       public:
-        ClusterMembers( Time delay): Neighbors( delay){
+        ClusterMembers( NeighborStore &store): Neighbors( store, NeighborStore::MEMBER){
         }
         virtual ~ClusterMembers(){
         }
         void Update( Ipv6Address addr, Time expire);
-        void Update( Ipv6Address addr, Time expire, HelloHeader header);
     };
   }
 }
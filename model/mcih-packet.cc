@@ -1,3 +1,7 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+
 #include "mcih-packet.h"
 #include "ns3/address-utils.h"
 #include "ns3/packet.h"
@@ -38,6 +42,8 @@ namespace ns3{
         case MCIHTYPE_RGSTREQ:
         case MCIHTYPE_RGSTREP:
         case MCIHTYPE_CHRESIGN:
+        case MCIHTYPE_RTUPDATE:
+        case MCIHTYPE_AGGREGATE:
           m_type= ( MessageType) type;
           break;
         default:
@@ -72,6 +78,12 @@ namespace ns3{
         case MCIHTYPE_RGSTREQ:
           os<< "RGSTREQ";
           break;
+        case MCIHTYPE_RTUPDATE:
+          os<< "RTUPDATE";
+          break;
+        case MCIHTYPE_AGGREGATE:
+          os<< "AGGREGATE";
+          break;
         case MCIHTYPE_RGSTREP:
         default:
           os<< "RGSTREP";
@@ -87,51 +99,150 @@ namespace ns3{
       return os;
     }
 
-    // テンプレート用のダミーヘッダ
-    NS_OBJECT_ENSURE_REGISTERED (HelloHeader);
-    HelloHeader::HelloHeader(): m_valid (true){
+    const double Quantizer::POSITION_RESOLUTION= 0.25;
+    const double Quantizer::VELOCITY_RESOLUTION= 0.01;
+    const uint8_t Quantizer::MAX_ABS_CM;
+    const double Quantizer::AGE_RESOLUTION= 0.05;
+
+    int16_t Quantizer::ToFixed( double value, double resolution){
+      double fixed= std::round( value/ resolution);
+      if( !( fixed> std::numeric_limits< int16_t>::min())) return std::numeric_limits< int16_t>::min(); // also nan
+      if( fixed> std::numeric_limits< int16_t>::max()) return std::numeric_limits< int16_t>::max();
+      return fixed;
     }
-    TypeId HelloHeader::GetTypeId () {
-      static TypeId tid = TypeId ("ns3::mcih::HelloHeader")
-        .SetParent<Header> ()
-        .SetGroupName("Mcih")
-        .AddConstructor<HelloHeader> ();
-      return tid;
+    bool Quantizer::IsInRange( double value, double resolution){
+      double fixed= std::round( value/ resolution);
+      return fixed>= std::numeric_limits< int16_t>::min()&& fixed<= std::numeric_limits< int16_t>::max();
     }
-    TypeId HelloHeader::GetInstanceTypeId (void) const{
-      return GetTypeId();
+    bool Quantizer::IsInRange( Vector origin, Vector position, Vector velocity){
+      return IsInRange( position.x- origin.x, POSITION_RESOLUTION)&& IsInRange( position.y- origin.y, POSITION_RESOLUTION)
+        && IsInRange( velocity.x, VELOCITY_RESOLUTION)&& IsInRange( velocity.y, VELOCITY_RESOLUTION);
     }
-    uint32_t HelloHeader::GetSerializedSize () const{
-      return (128+ 64*4+64+64+32+32)/8;
+    int32_t Quantizer::Drift( int16_t velocity, uint8_t age){
+      return std::lround( velocity* age* ( VELOCITY_RESOLUTION* AGE_RESOLUTION/ POSITION_RESOLUTION));
+    }
+    static bool IsShort( int32_t value){
+      return value>= std::numeric_limits< int8_t>::min()&& value<= std::numeric_limits< int8_t>::max();
+    }
+    uint8_t Quantizer::ToMetric( double value){
+      if( !( value< 1)) return 255; // also nan
+      if( value< 0) return 0;
+      return std::round( value* 255);
+    }
+
+    static const uint8_t LINK_LOCAL_PREFIX[ 8]= { 0xfe, 0x80, 0, 0, 0, 0, 0, 0};
+    static const uint8_t SHORT_IID[ 6]= { 0x02, 0, 0, 0xff, 0xfe, 0};
+    static const uint8_t ZERO_IID[ 8]= {};
+    // context is set and equals bytes in [ begin, end)
+    static bool Matches( Ipv6Address context, const uint8_t *bytes, size_t begin, size_t end){
+      if( context== Ipv6Address()) return false;
+      uint8_t other[ 16];
+      context.GetBytes( other);
+      return !memcmp( bytes+ begin, other+ begin, end- begin);
+    }
+    uint8_t AddressCompressor::GetMode( Ipv6Address address, const AddressContext *context){
+      if( address== Ipv6Address()) return UNSPECIFIED;
+      uint8_t bytes[ 16];
+      address.GetBytes( bytes);
+      uint8_t prefix= PREFIX_INLINE;
+      if( !memcmp( bytes, LINK_LOCAL_PREFIX, 8)) prefix= PREFIX_LINK_LOCAL;
+      else if( context&& Matches( context->link_prefix, bytes, 0, 8)) prefix= PREFIX_LINK;
+      else if( context&& Matches( context->cluster_space, bytes, 0, 6)) prefix= PREFIX_CLUSTER;
+      uint8_t iid= IID_INLINE;
+      if( context&& Matches( context->source, bytes, 8, 16)) iid= IID_SOURCE;
+      else if( !memcmp( bytes+ 8, ZERO_IID, 8)) iid= ( prefix== PREFIX_LINK_LOCAL)? IID_INLINE: IID_ZERO; // fe80:: itself is not unspecified
+      else if( !memcmp( bytes+ 8, SHORT_IID, 6)) iid= IID_SHORT;
+      return prefix| iid;
+    }
+    uint32_t AddressCompressor::GetSize( uint8_t mode){
+      static const uint32_t prefix_sizes[ 4]= { 8, 0, 0, 2};
+      static const uint32_t iid_sizes[ 4]= { 8, 2, 0, 0};
+      if( mode== UNSPECIFIED) return 0;
+      return prefix_sizes[ ( mode>> 2)& 0x3]+ iid_sizes[ mode& 0x3];
+    }
+    void AddressCompressor::Write( Buffer::Iterator &i, uint8_t mode, Ipv6Address address){
+      if( mode== UNSPECIFIED) return;
+      uint8_t bytes[ 16];
+      address.GetBytes( bytes);
+      if( ( mode& 0xc)== PREFIX_INLINE) i.Write( bytes, 8);
+      else if( ( mode& 0xc)== PREFIX_CLUSTER) i.Write( bytes+ 6, 2);
+      if( ( mode& 0x3)== IID_INLINE) i.Write( bytes+ 8, 8);
+      else if( ( mode& 0x3)== IID_SHORT) i.Write( bytes+ 14, 2);
+    }
+    Ipv6Address AddressCompressor::Read( Buffer::Iterator &i, uint8_t mode, const AddressContext &context){
+      uint8_t bytes[ 16];
+      i.Read( bytes, GetSize( mode));
+      return Decode( bytes, mode, context);
+    }
+    Ipv6Address AddressCompressor::Decode( const uint8_t *bytes, uint8_t mode, const AddressContext &context){
+      if( mode== UNSPECIFIED) return Ipv6Address();
+      uint8_t address[ 16]= {};
+      switch( mode& 0xc){
+        case PREFIX_INLINE:
+          memcpy( address, bytes, 8);
+          bytes+= 8;
+          break;
+        case PREFIX_LINK_LOCAL:
+          memcpy( address, LINK_LOCAL_PREFIX, 8);
+          break;
+        case PREFIX_LINK:
+          context.link_prefix.GetBytes( address);
+          break;
+        default:
+          context.cluster_space.GetBytes( address);
+          memcpy( address+ 6, bytes, 2);
+          bytes+= 2;
+      }
+      switch( mode& 0x3){
+        case IID_INLINE:
+          memcpy( address+ 8, bytes, 8);
+          break;
+        case IID_SHORT:
+          memcpy( address+ 8, SHORT_IID, 6);
+          memcpy( address+ 14, bytes, 2);
+          break;
+        case IID_SOURCE:{
+          uint8_t source[ 16];
+          context.source.GetBytes( source);
+          memcpy( address+ 8, source+ 8, 8);
+          break;
+        }
+        default:
+          memset( address+ 8, 0, 8);
+      }
+      return Ipv6Address( address);
     }
-    void HelloHeader::Serialize (Buffer::Iterator start) const{
-      WriteTo( start, address);
 
+    // position and velocity, shared by hello, unadv and mchadv
+    static uint32_t GetMotionSize( Encoding encoding){
+      return ( encoding== ENCODING_COMPACT? 2: 8)* 2* DIMENSION;
+    }
+    static void WriteMotion( Buffer::Iterator &i, Encoding encoding, Vector origin, Vector position, Vector velocity){
+      if( encoding== ENCODING_COMPACT){
+        i.WriteHtonU16( static_cast< uint16_t>( Quantizer::ToFixed( position.x- origin.x, Quantizer::POSITION_RESOLUTION)));
+        i.WriteHtonU16( static_cast< uint16_t>( Quantizer::ToFixed( position.y- origin.y, Quantizer::POSITION_RESOLUTION)));
+        i.WriteHtonU16( static_cast< uint16_t>( Quantizer::ToFixed( velocity.x, Quantizer::VELOCITY_RESOLUTION)));
+        i.WriteHtonU16( static_cast< uint16_t>( Quantizer::ToFixed( velocity.y, Quantizer::VELOCITY_RESOLUTION)));
+        return;
+      }
       uint64_t px, py, vx, vy;
       memcpy( &px, &position.x, sizeof( position.x));
       memcpy( &py, &position.y, sizeof( position.y));
       memcpy( &vx, &velocity.x, sizeof( velocity.x));
       memcpy( &vy, &velocity.y, sizeof( velocity.y));
-      start.WriteU64( px);
-      start.WriteU64( py);
-      start.WriteU64( vx);
-      start.WriteU64( vy);
-
-      uint64_t u64_rpm;
-      memcpy( &u64_rpm, &rpm, sizeof( rpm));
-      start.WriteU64( u64_rpm);
-      uint64_t u64_rsm;
-      memcpy( &u64_rsm, &rsm, sizeof( rsm));
-      start.WriteU64( u64_rsm);
-
-      // NS_LOG_LOGIC( "HELLO SERIALIZE "<< ToString( role)<< " "<< static_cast<uint32_t>(role));
-      start.WriteU32( static_cast<uint32_t>(role));
-      start.WriteU32( abs_cm);
-    }
-    uint32_t HelloHeader::Deserialize (Buffer::Iterator start){
-      Buffer::Iterator i = start;
-
-      ReadFrom( i, address);
+      i.WriteU64( px);
+      i.WriteU64( py);
+      i.WriteU64( vx);
+      i.WriteU64( vy);
+    }
+    static void ReadMotion( Buffer::Iterator &i, Encoding encoding, Vector origin, Vector &position, Vector &velocity){
+      if( encoding== ENCODING_COMPACT){
+        position.x= origin.x+ Quantizer::FromFixed( static_cast< int16_t>( i.ReadNtohU16()), Quantizer::POSITION_RESOLUTION);
+        position.y= origin.y+ Quantizer::FromFixed( static_cast< int16_t>( i.ReadNtohU16()), Quantizer::POSITION_RESOLUTION);
+        velocity.x= Quantizer::FromFixed( static_cast< int16_t>( i.ReadNtohU16()), Quantizer::VELOCITY_RESOLUTION);
+        velocity.y= Quantizer::FromFixed( static_cast< int16_t>( i.ReadNtohU16()), Quantizer::VELOCITY_RESOLUTION);
+        return;
+      }
       uint64_t px, py, vx, vy;
       px= i.ReadU64();
       py= i.ReadU64();
@@ -141,23 +252,293 @@ namespace ns3{
       memcpy( &position.y, &py, sizeof( velocity.y));
       memcpy( &velocity.x, &vx, sizeof( velocity.x));
       memcpy( &velocity.y, &vy, sizeof( velocity.y));
+    }
+    // rpm and rsm
+    static uint32_t GetMetricSize( Encoding encoding){
+      return encoding== ENCODING_COMPACT? 1: 8;
+    }
+    static void WriteMetric( Buffer::Iterator &i, Encoding encoding, double metric){
+      if( encoding== ENCODING_COMPACT){
+        i.WriteU8( Quantizer::ToMetric( metric));
+        return;
+      }
+      uint64_t u64_metric;
+      memcpy( &u64_metric, &metric, sizeof( metric));
+      i.WriteU64( u64_metric);
+    }
+    static double ReadMetric( Buffer::Iterator &i, Encoding encoding){
+      if( encoding== ENCODING_COMPACT) return Quantizer::FromMetric( i.ReadU8());
+      double metric;
+      uint64_t u64_metric= i.ReadU64();
+      memcpy( &metric, &u64_metric, sizeof( metric));
+      return metric;
+    }
+    // an address after its mode in the high nibble, for headers carrying one
+    static void WriteAddress( Buffer::Iterator &i, uint8_t mode, Ipv6Address address){
+      i.WriteU8( mode<< 4);
+      AddressCompressor::Write( i, mode, address);
+    }
+    static Ipv6Address ReadAddress( Buffer::Iterator &i, uint8_t &mode, const AddressContext &context){
+      mode= i.ReadU8()>> 4;
+      return AddressCompressor::Read( i, mode, context);
+    }
+    // flags gets the bits of mask, for messages that carry flags in the encoding byte.
+    // false for an encoding newer than last, the header is then invalid and its message dropped
+    static bool ReadEncoding( Buffer::Iterator &i, Encoding &encoding, Encoding last= ENCODING_COMPACT, uint8_t mask= 0, uint8_t *flags= 0){
+      uint8_t value= i.ReadU8();
+      if( flags) *flags= value& mask;
+      value&= ~mask;
+      if( value> last) return false;
+      encoding= static_cast< Encoding>( value);
+      return true;
+    }
 
-      uint64_t u64_rpm;
-      u64_rpm= i.ReadU64();
-      memcpy( &rpm, &u64_rpm, sizeof( rpm));
-      uint64_t u64_rsm;
-      u64_rsm= i.ReadU64();
-      memcpy( &rsm, &u64_rsm, sizeof( rsm));
+    // テンプレート用のダミーヘッダ
+    NS_OBJECT_ENSURE_REGISTERED (HelloHeader);
+    HelloHeader::HelloHeader(): m_valid (true), encoding( ENCODING_RAW), keyframe_request( false), origin( 0, 0, 0), contextual( false), address_mode( AddressCompressor::UNSPECIFIED), keyframe( 0), age( 0), fields( 0), rpm( 0), rsm( 0), role( Undecided), abs_cm( 0){
+    }
+    TypeId HelloHeader::GetTypeId () {
+      static TypeId tid = TypeId ("ns3::mcih::HelloHeader")
+        .SetParent<Header> ()
+        .SetGroupName("Mcih")
+        .AddConstructor<HelloHeader> ();
+      return tid;
+    }
+    TypeId HelloHeader::GetInstanceTypeId (void) const{
+      return GetTypeId();
+    }
+    uint32_t HelloHeader::GetSerializedSize () const{
+      switch( encoding){
+        case ENCODING_RAW:
+          return 1+ 1+ AddressCompressor::GetSize( address_mode)+ GetMotionSize( encoding)+ 2* GetMetricSize( encoding)+ 4+ 4;
+        case ENCODING_DELTA:{
+          uint32_t size= 4;
+          if( fields& DELTA_ADDRESS) size+= 1+ AddressCompressor::GetSize( address_mode);
+          if( fields& DELTA_POSITION_SHORT) size+= 2;
+          else if( fields& DELTA_POSITION) size+= 4;
+          if( fields& DELTA_VELOCITY_SHORT) size+= 2;
+          else if( fields& DELTA_VELOCITY) size+= 4;
+          if( fields& DELTA_RPM) size++;
+          if( fields& DELTA_RSM) size++;
+          if( fields& DELTA_ROLE) size++;
+          return size;
+        }
+        default:
+          return 1+ ( encoding== ENCODING_KEYFRAME? 1: 0)+ 1+ AddressCompressor::GetSize( address_mode)+ GetMotionSize( ENCODING_COMPACT)+ 3;
+      }
+    }
+    void HelloHeader::Serialize (Buffer::Iterator start) const{
+      start.WriteU8( encoding| ( keyframe_request? KEYFRAME_REQUEST: 0));
+      if( encoding== ENCODING_RAW){
+        WriteAddress( start, address_mode, address);
+        WriteMotion( start, encoding, origin, position, velocity);
+        WriteMetric( start, encoding, rpm);
+        WriteMetric( start, encoding, rsm);
+        // NS_LOG_LOGIC( "HELLO SERIALIZE "<< ToString( role)<< " "<< static_cast<uint32_t>(role));
+        start.WriteU32( static_cast<uint32_t>(role));
+        start.WriteU32( abs_cm);
+        return;
+      }
+      if( encoding== ENCODING_DELTA){
+        start.WriteU8( keyframe);
+        start.WriteU8( age);
+        start.WriteU8( fields);
+        if( fields& DELTA_ADDRESS) WriteAddress( start, address_mode, address);
+        if( fields& DELTA_POSITION_SHORT){
+          start.WriteU8( static_cast< uint8_t>( delta.position_x));
+          start.WriteU8( static_cast< uint8_t>( delta.position_y));
+        } else if( fields& DELTA_POSITION){
+          start.WriteHtonU16( static_cast< uint16_t>( delta.position_x));
+          start.WriteHtonU16( static_cast< uint16_t>( delta.position_y));
+        }
+        if( fields& DELTA_VELOCITY_SHORT){
+          start.WriteU8( static_cast< uint8_t>( delta.velocity_x));
+          start.WriteU8( static_cast< uint8_t>( delta.velocity_y));
+        } else if( fields& DELTA_VELOCITY){
+          start.WriteHtonU16( static_cast< uint16_t>( delta.velocity_x));
+          start.WriteHtonU16( static_cast< uint16_t>( delta.velocity_y));
+        }
+        if( fields& DELTA_RPM) start.WriteU8( delta.rpm);
+        if( fields& DELTA_RSM) start.WriteU8( delta.rsm);
+        if( fields& DELTA_ROLE) start.WriteU8( delta.role_abs_cm);
+        return;
+      }
+      if( encoding== ENCODING_KEYFRAME) start.WriteU8( keyframe);
+      HelloState state= GetState();
+      WriteAddress( start, address_mode, state.address);
+      start.WriteHtonU16( static_cast< uint16_t>( state.position_x));
+      start.WriteHtonU16( static_cast< uint16_t>( state.position_y));
+      start.WriteHtonU16( static_cast< uint16_t>( state.velocity_x));
+      start.WriteHtonU16( static_cast< uint16_t>( state.velocity_y));
+      start.WriteU8( state.rpm);
+      start.WriteU8( state.rsm);
+      start.WriteU8( state.role_abs_cm);
+    }
+    uint32_t HelloHeader::Deserialize (Buffer::Iterator start){
+      Buffer::Iterator i = start;
 
-      uint32_t r= i.ReadU32();
-      role= static_cast<Role>(r);
-      abs_cm= i.ReadU32();
-      // NS_LOG_LOGIC( "HELLO DESERIALIZE "<< ToString( static_cast<Role>( r))<< " "<< static_cast<Role>(r)<< " "<< rsm<< " "<< abs_cm);
+      uint8_t flags;
+      m_valid= ReadEncoding( i, encoding, ENCODING_DELTA, KEYFRAME_REQUEST, &flags);
+      if( !m_valid) return i.GetDistanceFrom( start);
+      keyframe_request= flags;
+      if( encoding== ENCODING_RAW){
+        address= ReadAddress( i, address_mode, address_context);
+        ReadMotion( i, encoding, origin, position, velocity);
+        rpm= ReadMetric( i, encoding);
+        rsm= ReadMetric( i, encoding);
+        uint32_t r= i.ReadU32();
+        role= static_cast<Role>(r);
+        abs_cm= i.ReadU32();
+        // NS_LOG_LOGIC( "HELLO DESERIALIZE "<< ToString( role)<< " "<< rsm<< " "<< abs_cm);
+      } else if( encoding== ENCODING_DELTA){ // the fields are known after Resolve
+        keyframe= i.ReadU8();
+        age= i.ReadU8();
+        fields= i.ReadU8();
+        delta= HelloState();
+        if( fields& DELTA_ADDRESS) address= ReadAddress( i, address_mode, address_context);
+        if( fields& DELTA_POSITION_SHORT){
+          delta.position_x= static_cast< int8_t>( i.ReadU8());
+          delta.position_y= static_cast< int8_t>( i.ReadU8());
+        } else if( fields& DELTA_POSITION){
+          delta.position_x= static_cast< int16_t>( i.ReadNtohU16());
+          delta.position_y= static_cast< int16_t>( i.ReadNtohU16());
+        }
+        if( fields& DELTA_VELOCITY_SHORT){
+          delta.velocity_x= static_cast< int8_t>( i.ReadU8());
+          delta.velocity_y= static_cast< int8_t>( i.ReadU8());
+        } else if( fields& DELTA_VELOCITY){
+          delta.velocity_x= static_cast< int16_t>( i.ReadNtohU16());
+          delta.velocity_y= static_cast< int16_t>( i.ReadNtohU16());
+        }
+        if( fields& DELTA_RPM) delta.rpm= i.ReadU8();
+        if( fields& DELTA_RSM) delta.rsm= i.ReadU8();
+        if( fields& DELTA_ROLE) delta.role_abs_cm= i.ReadU8();
+      } else{
+        if( encoding== ENCODING_KEYFRAME) keyframe= i.ReadU8();
+        HelloState state;
+        state.address= ReadAddress( i, address_mode, address_context);
+        state.position_x= static_cast< int16_t>( i.ReadNtohU16());
+        state.position_y= static_cast< int16_t>( i.ReadNtohU16());
+        state.velocity_x= static_cast< int16_t>( i.ReadNtohU16());
+        state.velocity_y= static_cast< int16_t>( i.ReadNtohU16());
+        state.rpm= i.ReadU8();
+        state.rsm= i.ReadU8();
+        state.role_abs_cm= i.ReadU8();
+        SetState( state);
+      }
 
       uint32_t dist= i.GetDistanceFrom( start);
       NS_ASSERT( dist== GetSerializedSize ());
       return dist;
     }
+    void HelloHeader::SetAddressContext( const AddressContext &c, bool contextual){
+      address_context= c;
+      this->contextual= contextual;
+      CompressAddresses();
+    }
+    void HelloHeader::CompressAddresses(){
+      address_mode= AddressCompressor::GetMode( address, contextual? &address_context: 0);
+    }
+    HelloState HelloHeader::GetState() const{
+      HelloState state;
+      state.keyframe= keyframe;
+      state.address= address;
+      state.position_x= Quantizer::ToFixed( position.x- origin.x, Quantizer::POSITION_RESOLUTION);
+      state.position_y= Quantizer::ToFixed( position.y- origin.y, Quantizer::POSITION_RESOLUTION);
+      state.velocity_x= Quantizer::ToFixed( velocity.x, Quantizer::VELOCITY_RESOLUTION);
+      state.velocity_y= Quantizer::ToFixed( velocity.y, Quantizer::VELOCITY_RESOLUTION);
+      state.rpm= Quantizer::ToMetric( rpm);
+      state.rsm= Quantizer::ToMetric( rsm);
+      state.role_abs_cm= static_cast< uint8_t>( role)<< 6| std::min< size_t>( abs_cm, Quantizer::MAX_ABS_CM);
+      return state;
+    }
+    void HelloHeader::SetState( const HelloState &state){
+      address= state.address;
+      position.x= origin.x+ Quantizer::FromFixed( state.position_x, Quantizer::POSITION_RESOLUTION);
+      position.y= origin.y+ Quantizer::FromFixed( state.position_y, Quantizer::POSITION_RESOLUTION);
+      velocity.x= Quantizer::FromFixed( state.velocity_x, Quantizer::VELOCITY_RESOLUTION);
+      velocity.y= Quantizer::FromFixed( state.velocity_y, Quantizer::VELOCITY_RESOLUTION);
+      rpm= Quantizer::FromMetric( state.rpm);
+      rsm= Quantizer::FromMetric( state.rsm);
+      role= static_cast< Role>( state.role_abs_cm>> 6);
+      abs_cm= state.role_abs_cm& Quantizer::MAX_ABS_CM;
+    }
+    void HelloHeader::SetKeyframe( uint8_t sequence){
+      encoding= ENCODING_KEYFRAME;
+      keyframe= sequence;
+    }
+    void HelloHeader::SetDelta( const HelloState &reference, uint8_t age){
+      HelloState state= GetState();
+      encoding= ENCODING_DELTA;
+      keyframe= reference.keyframe;
+      this->age= age;
+      fields= 0;
+      delta= HelloState();
+      if( state.address!= reference.address) fields|= DELTA_ADDRESS;
+
+      int32_t residual_x= state.position_x- ( reference.position_x+ Quantizer::Drift( reference.velocity_x, age));
+      int32_t residual_y= state.position_y- ( reference.position_y+ Quantizer::Drift( reference.velocity_y, age));
+      if( IsShort( residual_x)&& IsShort( residual_y)){
+        if( residual_x|| residual_y) fields|= DELTA_POSITION_SHORT;
+        delta.position_x= residual_x;
+        delta.position_y= residual_y;
+      } else{
+        fields|= DELTA_POSITION;
+        delta.position_x= state.position_x;
+        delta.position_y= state.position_y;
+      }
+
+      int32_t change_x= state.velocity_x- reference.velocity_x;
+      int32_t change_y= state.velocity_y- reference.velocity_y;
+      if( IsShort( change_x)&& IsShort( change_y)){
+        if( change_x|| change_y) fields|= DELTA_VELOCITY_SHORT;
+        delta.velocity_x= change_x;
+        delta.velocity_y= change_y;
+      } else{
+        fields|= DELTA_VELOCITY;
+        delta.velocity_x= state.velocity_x;
+        delta.velocity_y= state.velocity_y;
+      }
+
+      if( state.rpm!= reference.rpm) fields|= DELTA_RPM;
+      if( state.rsm!= reference.rsm) fields|= DELTA_RSM;
+      if( state.role_abs_cm!= reference.role_abs_cm) fields|= DELTA_ROLE;
+      delta.rpm= state.rpm;
+      delta.rsm= state.rsm;
+      delta.role_abs_cm= state.role_abs_cm;
+    }
+    bool HelloHeader::Resolve( const HelloState &reference){
+      NS_ASSERT( encoding== ENCODING_DELTA);
+      if( reference.keyframe!= keyframe) return false; // the keyframe was lost
+      HelloState state= reference;
+      if( fields& DELTA_ADDRESS) state.address= address;
+
+      int32_t position_x= reference.position_x+ Quantizer::Drift( reference.velocity_x, age);
+      int32_t position_y= reference.position_y+ Quantizer::Drift( reference.velocity_y, age);
+      if( fields& DELTA_POSITION_SHORT){
+        position_x+= delta.position_x;
+        position_y+= delta.position_y;
+      } else if( fields& DELTA_POSITION){
+        position_x= delta.position_x;
+        position_y= delta.position_y;
+      }
+      state.position_x= position_x;
+      state.position_y= position_y;
+
+      if( fields& DELTA_VELOCITY_SHORT){
+        state.velocity_x+= delta.velocity_x;
+        state.velocity_y+= delta.velocity_y;
+      } else if( fields& DELTA_VELOCITY){
+        state.velocity_x= delta.velocity_x;
+        state.velocity_y= delta.velocity_y;
+      }
+
+      if( fields& DELTA_RPM) state.rpm= delta.rpm;
+      if( fields& DELTA_RSM) state.rsm= delta.rsm;
+      if( fields& DELTA_ROLE) state.role_abs_cm= delta.role_abs_cm;
+      SetState( state);
+      return true;
+    }
     void HelloHeader::Print (std::ostream &os) const{
       os << "HELLO";
     }
@@ -171,7 +552,7 @@ namespace ns3{
 
     // 
     NS_OBJECT_ENSURE_REGISTERED (UnadvHeader);
-    UnadvHeader::UnadvHeader(): reserved( 0), sequence( 0){
+    UnadvHeader::UnadvHeader(): m_valid( true), encoding( ENCODING_RAW), origin( 0, 0, 0), reserved( 0), sequence( 0), rpm( 0){
       //position.resize( DIMENSION);
       //velocity.resize( DIMENSION);
     }
@@ -191,44 +572,23 @@ namespace ns3{
       return GetTypeId();
     }
     uint32_t UnadvHeader::GetSerializedSize () const{
-      return 1+ 2+ ( 8 + 8) * DIMENSION+ 8;
+      return 1+ ( encoding== ENCODING_COMPACT? 0: 1)+ 2+ GetMotionSize( encoding)+ GetMetricSize( encoding);
     }
     void UnadvHeader::Serialize (Buffer::Iterator start) const{
-      start.WriteU8( reserved);
+      start.WriteU8( encoding);
+      if( encoding!= ENCODING_COMPACT) start.WriteU8( reserved);
       start.WriteU16( sequence);
-
-      uint64_t px, py, vx, vy;
-      memcpy( &px, &position.x, sizeof( position.x));
-      memcpy( &py, &position.y, sizeof( position.y));
-      memcpy( &vx, &velocity.x, sizeof( velocity.x));
-      memcpy( &vy, &velocity.y, sizeof( velocity.y));
-      start.WriteU64( px);
-      start.WriteU64( py);
-      start.WriteU64( vx);
-      start.WriteU64( vy);
-
-      uint64_t u64_rpm;
-      memcpy( &u64_rpm, &rpm, sizeof( rpm));
-      start.WriteU64( u64_rpm);
+      WriteMotion( start, encoding, origin, position, velocity);
+      WriteMetric( start, encoding, rpm);
     }
     uint32_t UnadvHeader::Deserialize( Buffer::Iterator start){
       Buffer::Iterator i = start;
-      reserved= i.ReadU8();
+      m_valid= ReadEncoding( i, encoding);
+      if( !m_valid) return i.GetDistanceFrom( start);
+      if( encoding!= ENCODING_COMPACT) reserved= i.ReadU8();
       sequence= i.ReadU16();
-
-      uint64_t px, py, vx, vy;
-      px= i.ReadU64();
-      py= i.ReadU64();
-      vx= i.ReadU64();
-      vy= i.ReadU64();
-      memcpy( &position.x, &px, sizeof( velocity.x));
-      memcpy( &position.y, &py, sizeof( velocity.y));
-      memcpy( &velocity.x, &vx, sizeof( velocity.x));
-      memcpy( &velocity.y, &vy, sizeof( velocity.y));
-
-      uint64_t u64_rpm;
-      u64_rpm= i.ReadU64();
-      memcpy( &rpm, &u64_rpm, sizeof( rpm));
+      ReadMotion( i, encoding, origin, position, velocity);
+      rpm= ReadMetric( i, encoding);
 
       uint32_t dist= i.GetDistanceFrom( start);
       NS_ASSERT( dist== GetSerializedSize ());
@@ -248,7 +608,7 @@ namespace ns3{
 
     // 
     NS_OBJECT_ENSURE_REGISTERED (MchadvHeader);
-    MchadvHeader::MchadvHeader(){
+    MchadvHeader::MchadvHeader(): m_valid( true), encoding( ENCODING_RAW), origin( 0, 0, 0), rpm( 0), contextual( false), address_mode( AddressCompressor::UNSPECIFIED){
     }
     TypeId MchadvHeader::GetTypeId () {
       static TypeId tid = TypeId ("ns3::mcih::MchadvHeader")
@@ -261,46 +621,34 @@ namespace ns3{
       return GetTypeId();
     }
     uint32_t MchadvHeader::GetSerializedSize () const{
-      return 16+ ( 8 + 8) * DIMENSION+ 8;
+      return 1+ GetMotionSize( encoding)+ GetMetricSize( encoding)+ 1+ AddressCompressor::GetSize( address_mode);
     }
     void MchadvHeader::Serialize (Buffer::Iterator start) const{
-      uint64_t px, py, vx, vy;
-      memcpy( &px, &position.x, sizeof( position.x));
-      memcpy( &py, &position.y, sizeof( position.y));
-      memcpy( &vx, &velocity.x, sizeof( velocity.x));
-      memcpy( &vy, &velocity.y, sizeof( velocity.y));
-      start.WriteU64( px);
-      start.WriteU64( py);
-      start.WriteU64( vx);
-      start.WriteU64( vy);
-
-      uint64_t u64_rpm;
-      memcpy( &u64_rpm, &rpm, sizeof( rpm));
-      start.WriteU64( u64_rpm);
-      WriteTo( start, mch_address);
+      start.WriteU8( encoding);
+      WriteMotion( start, encoding, origin, position, velocity);
+      WriteMetric( start, encoding, rpm);
+      WriteAddress( start, address_mode, mch_address);
     }
     uint32_t MchadvHeader::Deserialize( Buffer::Iterator start){
       Buffer::Iterator i = start;
-    
-      uint64_t px, py, vx, vy;
-      px= i.ReadU64();
-      py= i.ReadU64();
-      vx= i.ReadU64();
-      vy= i.ReadU64();
-      memcpy( &position.x, &px, sizeof( velocity.x));
-      memcpy( &position.y, &py, sizeof( velocity.y));
-      memcpy( &velocity.x, &vx, sizeof( velocity.x));
-      memcpy( &velocity.y, &vy, sizeof( velocity.y));
-
-      uint64_t u64_rpm;
-      u64_rpm= i.ReadU64();
-      memcpy( &rpm, &u64_rpm, sizeof( rpm));
-      ReadFrom( i, mch_address);
+      m_valid= ReadEncoding( i, encoding);
+      if( !m_valid) return i.GetDistanceFrom( start);
+      ReadMotion( i, encoding, origin, position, velocity);
+      rpm= ReadMetric( i, encoding);
+      mch_address= ReadAddress( i, address_mode, address_context);
 
       uint32_t dist= i.GetDistanceFrom( start);
       NS_ASSERT( dist== GetSerializedSize ());
       return dist;
     }
+    void MchadvHeader::SetAddressContext( const AddressContext &c, bool contextual){
+      address_context= c;
+      this->contextual= contextual;
+      CompressAddresses();
+    }
+    void MchadvHeader::CompressAddresses(){
+      address_mode= AddressCompressor::GetMode( mch_address, contextual? &address_context: 0);
+    }
     void MchadvHeader::Print (std::ostream &os) const{
       os<< "Mchadv";
     }
@@ -314,7 +662,7 @@ namespace ns3{
     
     // 
     NS_OBJECT_ENSURE_REGISTERED( ElectMchHeader);
-    ElectMchHeader::ElectMchHeader(){
+    ElectMchHeader::ElectMchHeader(): contextual( false), address_mode( AddressCompressor::UNSPECIFIED){
     }
     TypeId ElectMchHeader::GetTypeId () {
       static TypeId tid = TypeId ("ns3::mcih::ElectMchHeader")
@@ -327,19 +675,27 @@ namespace ns3{
       return GetTypeId();
     }
     uint32_t ElectMchHeader::GetSerializedSize () const{
-      return 128/ 8;
+      return 1+ AddressCompressor::GetSize( address_mode);
     }
     void ElectMchHeader::Serialize (Buffer::Iterator start) const{
-      WriteTo( start, elect_server_address);
+      WriteAddress( start, address_mode, elect_server_address);
     }
     uint32_t ElectMchHeader::Deserialize( Buffer::Iterator start){
       Buffer::Iterator itr = start;
-      ReadFrom( itr, elect_server_address);
+      elect_server_address= ReadAddress( itr, address_mode, address_context);
 
       uint32_t dist= itr.GetDistanceFrom( start);
       NS_ASSERT( dist== GetSerializedSize ());
       return dist;
     }
+    void ElectMchHeader::SetAddressContext( const AddressContext &c, bool contextual){
+      address_context= c;
+      this->contextual= contextual;
+      CompressAddresses();
+    }
+    void ElectMchHeader::CompressAddresses(){
+      address_mode= AddressCompressor::GetMode( elect_server_address, contextual? &address_context: 0);
+    }
     void ElectMchHeader::Print (std::ostream &os) const{
       os<< "Elect Master Cluster Header";
     }
@@ -353,7 +709,7 @@ namespace ns3{
 
     // 
     NS_OBJECT_ENSURE_REGISTERED( RgstreqHeader);
-    RgstreqHeader::RgstreqHeader(){
+    RgstreqHeader::RgstreqHeader(): contextual( false), address_modes( AddressCompressor::UNSPECIFIED<< 4| AddressCompressor::UNSPECIFIED){
     }
     TypeId RgstreqHeader::GetTypeId () {
       static TypeId tid = TypeId ("ns3::mcih::RgstreqHeader")
@@ -366,21 +722,32 @@ namespace ns3{
       return GetTypeId();
     }
     uint32_t RgstreqHeader::GetSerializedSize () const{
-      return 128/ 8* 2;
+      return 1+ AddressCompressor::GetSize( address_modes>> 4)+ AddressCompressor::GetSize( address_modes& 0xf);
     }
     void RgstreqHeader::Serialize (Buffer::Iterator start) const{
-      WriteTo( start, router_address);
-      WriteTo( start, regist_address);
+      start.WriteU8( address_modes);
+      AddressCompressor::Write( start, address_modes>> 4, router_address);
+      AddressCompressor::Write( start, address_modes& 0xf, regist_address);
     }
     uint32_t RgstreqHeader::Deserialize( Buffer::Iterator start){
       Buffer::Iterator itr = start;
-      ReadFrom( itr, router_address);
-      ReadFrom( itr, regist_address);
+      address_modes= itr.ReadU8();
+      router_address= AddressCompressor::Read( itr, address_modes>> 4, address_context);
+      regist_address= AddressCompressor::Read( itr, address_modes& 0xf, address_context);
 
       uint32_t dist= itr.GetDistanceFrom( start);
       NS_ASSERT( dist== GetSerializedSize ());
       return dist;
     }
+    void RgstreqHeader::SetAddressContext( const AddressContext &c, bool contextual){
+      address_context= c;
+      this->contextual= contextual;
+      CompressAddresses();
+    }
+    void RgstreqHeader::CompressAddresses(){
+      const AddressContext *context= contextual? &address_context: 0;
+      address_modes= AddressCompressor::GetMode( router_address, context)<< 4| AddressCompressor::GetMode( regist_address, context);
+    }
     void RgstreqHeader::Print (std::ostream &os) const{
       os<< "Elect Master Cluster Header";
     }
@@ -394,7 +761,7 @@ namespace ns3{
 
     // 
     NS_OBJECT_ENSURE_REGISTERED( RgstrepHeader);
-    RgstrepHeader::RgstrepHeader(){
+    RgstrepHeader::RgstrepHeader(): contextual( false), address_modes( AddressCompressor::UNSPECIFIED<< 4| AddressCompressor::UNSPECIFIED){
     }
     TypeId RgstrepHeader::GetTypeId () {
       static TypeId tid = TypeId ("ns3::mcih::RgstrepHeader")
@@ -407,19 +774,32 @@ namespace ns3{
       return GetTypeId();
     }
     uint32_t RgstrepHeader::GetSerializedSize () const{
-      return 128/ 8;
+      return 1+ AddressCompressor::GetSize( address_modes>> 4)+ AddressCompressor::GetSize( address_modes& 0xf);
     }
     void RgstrepHeader::Serialize (Buffer::Iterator start) const{
-      WriteTo( start, router_address);
+      start.WriteU8( address_modes);
+      AddressCompressor::Write( start, address_modes>> 4, router_address);
+      AddressCompressor::Write( start, address_modes& 0xf, cluster_prefix); // the interface id half is always zero
     }
     uint32_t RgstrepHeader::Deserialize( Buffer::Iterator start){
       Buffer::Iterator itr = start;
-      ReadFrom( itr, router_address);
+      address_modes= itr.ReadU8();
+      router_address= AddressCompressor::Read( itr, address_modes>> 4, address_context);
+      cluster_prefix= AddressCompressor::Read( itr, address_modes& 0xf, address_context);
 
       uint32_t dist= itr.GetDistanceFrom( start);
       NS_ASSERT( dist== GetSerializedSize ());
       return dist;
     }
+    void RgstrepHeader::SetAddressContext( const AddressContext &c, bool contextual){
+      address_context= c;
+      this->contextual= contextual;
+      CompressAddresses();
+    }
+    void RgstrepHeader::CompressAddresses(){
+      const AddressContext *context= contextual? &address_context: 0;
+      address_modes= AddressCompressor::GetMode( router_address, context)<< 4| AddressCompressor::GetMode( cluster_prefix, context);
+    }
     void RgstrepHeader::Print (std::ostream &os) const{
       os<< "Elect Master Cluster Header";
     }
@@ -433,7 +813,7 @@ namespace ns3{
 
     // 
     NS_OBJECT_ENSURE_REGISTERED( ResignHeader);
-    ResignHeader::ResignHeader(){
+    ResignHeader::ResignHeader(): contextual( false), address_mode( AddressCompressor::UNSPECIFIED){
     }
     TypeId ResignHeader::GetTypeId () {
       static TypeId tid = TypeId ("ns3::mcih::ResignHeader")
@@ -446,19 +826,27 @@ namespace ns3{
       return GetTypeId();
     }
     uint32_t ResignHeader::GetSerializedSize () const{
-      return 128/ 8;
+      return 1+ AddressCompressor::GetSize( address_mode);
     }
     void ResignHeader::Serialize (Buffer::Iterator start) const{
-      WriteTo( start, address);
+      WriteAddress( start, address_mode, address);
     }
     uint32_t ResignHeader::Deserialize( Buffer::Iterator start){
       Buffer::Iterator itr = start;
-      ReadFrom( itr, address);
+      address= ReadAddress( itr, address_mode, address_context);
 
       uint32_t dist= itr.GetDistanceFrom( start);
       NS_ASSERT( dist== GetSerializedSize ());
       return dist;
     }
+    void ResignHeader::SetAddressContext( const AddressContext &c, bool contextual){
+      address_context= c;
+      this->contextual= contextual;
+      CompressAddresses();
+    }
+    void ResignHeader::CompressAddresses(){
+      address_mode= AddressCompressor::GetMode( address, contextual? &address_context: 0);
+    }
     void ResignHeader::Print (std::ostream &os) const{
       os<< "Cluster Head Resign";
     }
@@ -508,5 +896,103 @@ namespace ns3{
       h.Print (os);
       return os;
     }
+
+    // 
+    NS_OBJECT_ENSURE_REGISTERED( RouteUpdateHeader);
+    const uint8_t RouteUpdateHeader::INFINITY_METRIC;
+    const uint32_t RouteUpdateHeader::RTE_SIZE;
+    RouteUpdateHeader::RouteUpdateHeader(){
+    }
+    TypeId RouteUpdateHeader::GetTypeId () {
+      static TypeId tid = TypeId ("ns3::mcih::RouteUpdateHeader")
+        .SetParent<Header> ()
+        .SetGroupName("Mcih")
+        .AddConstructor<RouteUpdateHeader> ();
+      return tid;
+    }
+    TypeId RouteUpdateHeader::GetInstanceTypeId (void) const{
+      return GetTypeId();
+    }
+    uint32_t RouteUpdateHeader::GetSerializedSize () const{
+      return GetEmptySize()+ rtes.size()* RTE_SIZE;
+    }
+    void RouteUpdateHeader::Serialize (Buffer::Iterator start) const{
+      start.WriteHtonU16( rtes.size());
+      for( auto itr= rtes.begin(); itr!= rtes.end(); itr++){
+        WriteTo( start, itr->prefix);
+        start.WriteHtonU16( itr->tag);
+        start.WriteU8( itr->prefix_length);
+        start.WriteU8( itr->metric);
+      }
+    }
+    uint32_t RouteUpdateHeader::Deserialize( Buffer::Iterator start){
+      Buffer::Iterator itr = start;
+      uint16_t count= itr.ReadNtohU16();
+      rtes.resize( count);
+      for( uint16_t index= 0; index< count; index++){
+        ReadFrom( itr, rtes[ index].prefix);
+        rtes[ index].tag= itr.ReadNtohU16();
+        rtes[ index].prefix_length= itr.ReadU8();
+        rtes[ index].metric= itr.ReadU8();
+      }
+
+      uint32_t dist= itr.GetDistanceFrom( start);
+      NS_ASSERT( dist== GetSerializedSize ());
+      return dist;
+    }
+    void RouteUpdateHeader::Print (std::ostream &os) const{
+      os<< "Route Update";
+      for( auto itr= rtes.begin(); itr!= rtes.end(); itr++){
+        os<< " "<< itr->prefix<< "/"<< ( uint32_t) itr->prefix_length<< "("<< ( uint32_t) itr->metric<< ")";
+      }
+    }
+    bool RouteUpdateHeader::operator== (RouteUpdateHeader const & o) const {
+      return 1;
+    }
+    std::ostream & operator<< (std::ostream & os, RouteUpdateHeader const & h) {
+      h.Print (os);
+      return os;
+    }
+
+    // 
+    NS_OBJECT_ENSURE_REGISTERED( TlvHeader);
+    TlvHeader::TlvHeader( MessageType t, uint16_t l): type( t), length( l){
+    }
+    TypeId TlvHeader::GetTypeId () {
+      static TypeId tid = TypeId ("ns3::mcih::TlvHeader")
+        .SetParent<Header> ()
+        .SetGroupName("Mcih")
+        .AddConstructor<TlvHeader> ();
+      return tid;
+    }
+    TypeId TlvHeader::GetInstanceTypeId (void) const{
+      return GetTypeId();
+    }
+    uint32_t TlvHeader::GetSerializedSize () const{
+      return 1+ 2;
+    }
+    void TlvHeader::Serialize (Buffer::Iterator start) const{
+      start.WriteU8( type);
+      start.WriteHtonU16( length);
+    }
+    uint32_t TlvHeader::Deserialize( Buffer::Iterator start){
+      Buffer::Iterator itr = start;
+      type= static_cast< MessageType>( itr.ReadU8()); // unknown types are skipped by length
+      length= itr.ReadNtohU16();
+
+      uint32_t dist= itr.GetDistanceFrom( start);
+      NS_ASSERT( dist== GetSerializedSize ());
+      return dist;
+    }
+    void TlvHeader::Print (std::ostream &os) const{
+      os<< TypeHeader( type)<< " "<< length;
+    }
+    bool TlvHeader::operator== (TlvHeader const & o) const {
+      return type== o.type&& length== o.length;
+    }
+    std::ostream & operator<< (std::ostream & os, TlvHeader const & h) {
+      h.Print (os);
+      return os;
+    }
   } 
 }
@@ -27,6 +27,90 @@ namespace ns3{
      typedef std::vector< uint16_t> Position;
      typedef std::vector< uint16_t> Velocity;
 
+      /*
+       * the first byte of hello, unadv and mchadv, receivers accept every encoding whatever they send.
+       * compact writes positions and velocities as 16 bit fixed point, positions relative to an origin
+       * every node agrees on, and rpm and rsm as 8 bit fractions of 1.
+       * keyframe and delta are hello only, a compact hello numbered for later deltas and the fields
+       * changed since the keyframe of that number.
+       */
+      enum Encoding{
+        ENCODING_RAW= 0,
+        ENCODING_COMPACT= 1,
+        ENCODING_KEYFRAME= 2,
+        ENCODING_DELTA= 3
+      };
+      class Quantizer{
+        public:
+          static const double POSITION_RESOLUTION; // m, +-8 km around the origin
+          static const double VELOCITY_RESOLUTION; // m/s, +-327 m/s
+          static const uint8_t MAX_ABS_CM= 63; // abs cm saturates, it shares a byte with the role
+          static int16_t ToFixed( double value, double resolution); // saturates out of range
+          static bool IsInRange( double value, double resolution); // ToFixed keeps it, false for nan
+          // position relative to origin and velocity fit the compact encoding
+          static bool IsInRange( Vector origin, Vector position, Vector velocity);
+          static double FromFixed( int16_t value, double resolution){ return value* resolution;}
+          static uint8_t ToMetric( double value); // 0 to 1, nan is the worst
+          static double FromMetric( uint8_t value){ return value/ 255.0;}
+          static const double AGE_RESOLUTION; // s, age of a delta against its keyframe
+          // movement in position units within age at velocity, both sides of a delta compute the same
+          static int32_t Drift( int16_t velocity, uint8_t age);
+      };
+
+      // a hello in fixed point, a keyframe is kept in it by both sides and deltas are taken against it
+      struct HelloState{
+        uint8_t keyframe;
+        Ipv6Address address;
+        int16_t position_x;
+        int16_t position_y;
+        int16_t velocity_x;
+        int16_t velocity_y;
+        uint8_t rpm;
+        uint8_t rsm;
+        uint8_t role_abs_cm;
+        HelloState(): keyframe( 0), position_x( 0), position_y( 0), velocity_x( 0), velocity_y( 0), rpm( 0), rsm( 0), role_abs_cm( 0){
+        }
+      };
+
+      /*
+       * node addresses in control headers, compressed against what both ends of a link know as 6lowpan
+       * iphc does. a mode nibble per address, the prefix in its high two bits and the interface id in
+       * the low two bits:
+       *   prefix       inline 64 bits, fe80::/64, global /64 of the link, cluster space /48 and 16 bits
+       *   interface id inline 64 bits, 16 bits after 0200:00ff:fe00, the one of the link local source, zero
+       * the short form is the interface id ns-3 autoconfigures from the Mac48Address it allocates, u/l bit set,
+       * not the 0000:00ff:fe00 of rfc 6282.
+       * link local prefix with zero interface id is the unspecified address.
+       * the link, cluster and source contexts are stateful and only used for the message types negotiated
+       * for them, the other forms always are. receivers accept every mode whatever they send.
+       */
+      struct AddressContext{
+        Ipv6Address source; // link local source of the message, Ipv6Address() when its interface id is not shared
+        Ipv6Address link_prefix; // global /64 of the link, Ipv6Address() without one
+        Ipv6Address cluster_space; // /48 of the cluster prefixes, Ipv6Address() without one
+      };
+      class AddressCompressor{
+        public:
+          enum Mode{
+            PREFIX_INLINE= 0x0,
+            PREFIX_LINK_LOCAL= 0x4,
+            PREFIX_LINK= 0x8,
+            PREFIX_CLUSTER= 0xc,
+            IID_INLINE= 0x0,
+            IID_SHORT= 0x1,
+            IID_SOURCE= 0x2,
+            IID_ZERO= 0x3,
+            UNSPECIFIED= PREFIX_LINK_LOCAL| IID_ZERO
+          };
+          // the shortest mode for address, stateless forms only without a context
+          static uint8_t GetMode( Ipv6Address address, const AddressContext *context);
+          static uint32_t GetSize( uint8_t mode);
+          static void Write( Buffer::Iterator &i, uint8_t mode, Ipv6Address address);
+          static Ipv6Address Read( Buffer::Iterator &i, uint8_t mode, const AddressContext &context);
+          // of GetSize( mode) bytes copied out of a packet, for a look before deserializing
+          static Ipv6Address Decode( const uint8_t *bytes, uint8_t mode, const AddressContext &context);
+      };
+
       enum MessageType {
          MCIHTYPE_HELLO= 0,
          MCIHTYPE_MCHADV= 1,
@@ -36,7 +120,9 @@ namespace ns3{
          MCIHTYPE_ELECTMCH= 5,
          MCIHTYPE_RGSTREQ= 6,
          MCIHTYPE_RGSTREP= 7,
-         MCIHTYPE_CHRESIGN= 8
+         MCIHTYPE_CHRESIGN= 8,
+         MCIHTYPE_RTUPDATE= 9,
+         MCIHTYPE_AGGREGATE= 10
       };
 
       /*
@@ -63,12 +149,30 @@ namespace ns3{
       std::ostream &operator<<( std::ostream &os, TypeHeader const &h);
 
 
-      /* テンプレート用のダミーヘッダ
+      /* Hello, compact encoding
        *  0                   1                   2                   3
        *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |     Type      |J|R|G|D|U|   Reserved          |   Hop Count   |
+       * |   Encoding    | Address Mode  |          Position_x           |
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |          Position_y           |          Velocity_x           |
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |          Velocity_y           |      RPM      |      RSM      |
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |Rol|  Abs Cm   |
+       * +-+-+-+-+-+-+-+-+
+       * the address follows its mode in the high nibble, 0 to 16 bytes, none here.
+       * raw encoding carries doubles, a 64 bit rpm and rsm and 32 bit role and abs cm after the address,
+       * keyframe puts a keyframe number after the encoding.
+       * the high bit of the encoding asks the neighbors for a keyframe, in any encoding.
+       *
+       * Hello, delta encoding
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |   Encoding    |   Keyframe    |      Age      |    Fields     |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       *   ... the fields set, in the order of DeltaField, the address with its mode before it. short positions are 8 bit offsets from the
+       *   keyframe position moved by the keyframe velocity for age, short velocities 8 bit offsets
+       *   from the keyframe velocity, the others are written in full.
        */
       class HelloHeader: public Header{
          public:
@@ -88,16 +192,54 @@ namespace ns3{
             RSM GetRelativeStateAndMobility(){ return rsm;}
             Role GetRole(){ return role;}
             size_t GetAbsCm(){ return abs_cm;}
-            void SetAddress( Ipv6Address addr){ address= addr;}
+            void SetAddress( Ipv6Address addr){ address= addr; CompressAddresses();}
             void SetPosition( Vector pos){ position= pos;}
             void SetVelocity( Vector vel){ velocity= vel;}
             void SetRelativePositionAndMobility( RPM r){ rpm= r;}
             void SetRelativeStateAndMobility( RSM r){ rsm= r;}
             void SetRole( Role r){ role= r;}
             void SetAbsCm( size_t a){ abs_cm= a;}
+            Encoding GetEncoding() const{ return encoding;}
+            void SetEncoding( Encoding e){ encoding= e;}
+            // of compact positions, set before serializing and before deserializing
+            void SetOrigin( Vector o){ origin= o;}
+            // of the link, set before serializing and before deserializing, contextual when negotiated for hello
+            void SetAddressContext( const AddressContext &c, bool contextual= false);
+            enum DeltaField{
+              DELTA_ADDRESS= 0x01,
+              DELTA_POSITION= 0x02,
+              DELTA_POSITION_SHORT= 0x04,
+              DELTA_VELOCITY= 0x08,
+              DELTA_VELOCITY_SHORT= 0x10,
+              DELTA_RPM= 0x20,
+              DELTA_RSM= 0x40,
+              DELTA_ROLE= 0x80
+            };
+            HelloState GetState() const;
+            void SetState( const HelloState &state);
+            // sent as keyframe number sequence
+            void SetKeyframe( uint8_t sequence);
+            // sent as the fields changed since reference, age in AGE_RESOLUTION after it
+            void SetDelta( const HelloState &reference, uint8_t age);
+            // fills a received delta in from the keyframe of its sender, false when reference is another keyframe
+            bool Resolve( const HelloState &reference);
+            enum{ KEYFRAME_REQUEST= 0x80}; // in the encoding byte
+            // the sender could not resolve a delta and wants the next hello of its neighbors as keyframe
+            bool GetKeyframeRequest() const{ return keyframe_request;}
+            void SetKeyframeRequest( bool r){ keyframe_request= r;}
             bool operator==( HelloHeader const & o) const;
          private:
             bool m_valid;
+            Encoding encoding;
+            bool keyframe_request;
+            Vector origin;
+            AddressContext address_context;
+            bool contextual;
+            uint8_t address_mode;
+            uint8_t keyframe;
+            uint8_t age;
+            uint8_t fields; // DeltaField
+            HelloState delta; // offsets or values of the fields set
             Ipv6Address address;
             Vector position;
             Vector velocity;
@@ -105,6 +247,7 @@ namespace ns3{
             RSM rsm;
             Role role;
             size_t abs_cm;
+            void CompressAddresses();
       };
       std::ostream & operator<< (std::ostream & os, HelloHeader const & h);
 
@@ -112,12 +255,13 @@ namespace ns3{
        *  0                   1                   2                   3
        *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |     Type      |    Reserved   |        Sequence Number        |
+       * |   Encoding    |        Sequence Number        |  Position_x   |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |          Position_x           |          Position_y           |
+       * |  Position_x   |          Position_y           |  Velocity_x   |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |          Velocity_x           |          Velocity_y           |
+       * |  Velocity_x   |          Velocity_y           |      RPM      |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * raw encoding has a reserved byte before the sequence number and carries doubles
        */
       class UnadvHeader: public Header{
         public:
@@ -131,7 +275,11 @@ namespace ns3{
           void Print( std::ostream &os) const;
 
           bool operator==( UnadvHeader const & o) const;
+          bool IsValid() const{ return m_valid;} // false for an unknown encoding
         private:
+          bool m_valid;
+          Encoding encoding;
+          Vector origin;
           uint8_t reserved;
           uint16_t sequence;
           Vector position;
@@ -144,6 +292,9 @@ namespace ns3{
           void SetPosition( Vector pos){ position= pos;}
           void SetVelocity( Vector vel){ velocity= vel;}
           void SetRelativePositionAndMobility( RPM r){ rpm= r;};
+          Encoding GetEncoding() const{ return encoding;}
+          void SetEncoding( Encoding e){ encoding= e;}
+          void SetOrigin( Vector o){ origin= o;}
       };
       std::ostream & operator<<( std::ostream & os, UnadvHeader const & h);
 
@@ -152,12 +303,14 @@ namespace ns3{
        *  0                   1                   2                   3
        *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |     Type      |    Reserved   |        Sequence Number        |
+       * |   Encoding    |          Position_x           |  Position_y   |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |          Position_x           |          Position_y           |
+       * |  Position_y   |          Velocity_x           |  Velocity_y   |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |          Velocity_x           |          Velocity_y           |
+       * |  Velocity_y   |      RPM      | Address Mode  |  mch address  |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       *   ... 0 to 16 bytes of mch address by its mode in the high nibble
+       * raw encoding carries doubles
        */
       class MchadvHeader: public Header{
         public:
@@ -170,11 +323,19 @@ namespace ns3{
           void Print( std::ostream &os) const;
 
           bool operator==( MchadvHeader const &o) const;
+          bool IsValid() const{ return m_valid;} // false for an unknown encoding
         private:
+          bool m_valid;
+          Encoding encoding;
+          Vector origin;
           Vector position;
           Vector velocity;
           RPM rpm;
           Ipv6Address mch_address;
+          AddressContext address_context;
+          bool contextual;
+          uint8_t address_mode;
+          void CompressAddresses();
         public: // accesser for parameter
           Vector GetPosition() const{ return position;}
           Vector GetVelocity() const{ return velocity;}
@@ -183,7 +344,11 @@ namespace ns3{
           void SetVelocity( Vector vel){ velocity= vel;}
           void SetRelativePositionAndMobility( RPM r){ rpm= r;}
           Ipv6Address GetMchAddress(){ return mch_address;}
-          void SetMchAddress( Ipv6Address address){ mch_address= address; }
+          void SetMchAddress( Ipv6Address address){ mch_address= address; CompressAddresses(); }
+          Encoding GetEncoding() const{ return encoding;}
+          void SetEncoding( Encoding e){ encoding= e;}
+          void SetOrigin( Vector o){ origin= o;}
+          void SetAddressContext( const AddressContext &c, bool contextual= false);
       };
       std::ostream &operator<<( std::ostream & os, MchadvHeader const & h);
 
@@ -191,10 +356,7 @@ namespace ns3{
        *  0                   1                   2                   3
        *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |                                                               |
-       * |                                                               |
-       * |                              ipv6                             |
-       * |                                                               |
+       * | Address Mode  |     ipv6, 0 to 16 bytes by the high nibble    |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
        */
       class ElectMchHeader: public Header{
@@ -203,7 +365,8 @@ namespace ns3{
           static TypeId GetTypeId();
           TypeId GetInstanceTypeId( void) const;
           Ipv6Address GetTargetAddress() const{ return elect_server_address;}
-          void SetTargetAddress( const Ipv6Address dst){ elect_server_address= dst; }
+          void SetTargetAddress( const Ipv6Address dst){ elect_server_address= dst; CompressAddresses(); }
+          void SetAddressContext( const AddressContext &c, bool contextual= false);
           uint32_t GetSerializedSize() const;
           void Serialize( Buffer::Iterator start) const;
           uint32_t Deserialize( Buffer::Iterator start);
@@ -212,6 +375,10 @@ namespace ns3{
           bool operator==( ElectMchHeader const &o) const;
         private:
           Ipv6Address elect_server_address;
+          AddressContext address_context;
+          bool contextual;
+          uint8_t address_mode;
+          void CompressAddresses();
       };
       std::ostream &operator<<( std::ostream & os, ElectMchHeader const & h);
 
@@ -219,10 +386,7 @@ namespace ns3{
        *  0                   1                   2                   3
        *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |                                                               |
-       * |                                                               |
-       * |                              ipv6                             |
-       * |                                                               |
+       * | Address Mode  | target ipv6, then regist ipv6, by each nibble |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
        */
       class RgstreqHeader: public Header{
@@ -231,9 +395,10 @@ namespace ns3{
           static TypeId GetTypeId();
           TypeId GetInstanceTypeId( void) const;
           Ipv6Address GetTargetAddress() const{ return router_address;}
-          void SetTargetAddress( const Ipv6Address dst){ router_address= dst; }
+          void SetTargetAddress( const Ipv6Address dst){ router_address= dst; CompressAddresses(); }
           Ipv6Address GetRegistAddress() const{ return regist_address;}
-          void SetRegistAddress( const Ipv6Address dst){ regist_address= dst; }
+          void SetRegistAddress( const Ipv6Address dst){ regist_address= dst; CompressAddresses(); }
+          void SetAddressContext( const AddressContext &c, bool contextual= false);
           uint32_t GetSerializedSize() const;
           void Serialize( Buffer::Iterator start) const;
           uint32_t Deserialize( Buffer::Iterator start);
@@ -243,6 +408,10 @@ namespace ns3{
         private:
           Ipv6Address router_address;
           Ipv6Address regist_address;
+          AddressContext address_context;
+          bool contextual;
+          uint8_t address_modes; // target in the high nibble
+          void CompressAddresses();
       };
       std::ostream &operator<<( std::ostream & os, RgstreqHeader const & h);
 
@@ -250,10 +419,7 @@ namespace ns3{
        *  0                   1                   2                   3
        *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |                                                               |
-       * |                                                               |
-       * |                              ipv6                             |
-       * |                                                               |
+       * | Address Mode  | head ipv6, then cluster prefix /64, by nibble |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
        */
       class RgstrepHeader: public Header{
@@ -262,7 +428,11 @@ namespace ns3{
           static TypeId GetTypeId();
           TypeId GetInstanceTypeId( void) const;
           Ipv6Address GetHeaderAddress() const{ return router_address;}
-          void SetHeaderAddress( const Ipv6Address dst){ router_address= dst; }
+          void SetHeaderAddress( const Ipv6Address dst){ router_address= dst; CompressAddresses(); }
+          // members configure their address from it, Ipv6Address() when the head has none
+          Ipv6Address GetClusterPrefix() const{ return cluster_prefix;}
+          void SetClusterPrefix( const Ipv6Address prefix){ cluster_prefix= prefix.CombinePrefix( Ipv6Prefix( 64)); CompressAddresses(); }
+          void SetAddressContext( const AddressContext &c, bool contextual= false);
           uint32_t GetSerializedSize() const;
           void Serialize( Buffer::Iterator start) const;
           uint32_t Deserialize( Buffer::Iterator start);
@@ -271,6 +441,11 @@ namespace ns3{
           bool operator==( RgstrepHeader const &o) const;
         private:
           Ipv6Address router_address;
+          Ipv6Address cluster_prefix;
+          AddressContext address_context;
+          bool contextual;
+          uint8_t address_modes; // head address in the high nibble
+          void CompressAddresses();
       };
       std::ostream &operator<<( std::ostream & os, RgstrepHeader const & h);
 
@@ -278,10 +453,7 @@ namespace ns3{
        *  0                   1                   2                   3
        *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-       * |                                                               |
-       * |                                                               |
-       * |                              ipv6                             |
-       * |                                                               |
+       * | Address Mode  |     ipv6, 0 to 16 bytes by the high nibble    |
        * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
        */
       class ResignHeader: public Header{
@@ -290,7 +462,8 @@ namespace ns3{
           static TypeId GetTypeId();
           TypeId GetInstanceTypeId( void) const;
           Ipv6Address GetHeaderAddress() const{ return address;}
-          void SetHeaderAddress( const Ipv6Address dst){ address= dst; }
+          void SetHeaderAddress( const Ipv6Address dst){ address= dst; CompressAddresses(); }
+          void SetAddressContext( const AddressContext &c, bool contextual= false);
           uint32_t GetSerializedSize() const;
           void Serialize( Buffer::Iterator start) const;
           uint32_t Deserialize( Buffer::Iterator start);
@@ -299,6 +472,10 @@ namespace ns3{
           bool operator==( ResignHeader const &o) const;
         private:
           Ipv6Address address;
+          AddressContext address_context;
+          bool contextual;
+          uint8_t address_mode;
+          void CompressAddresses();
       };
       std::ostream &operator<<( std::ostream & os, ResignHeader const & h);
 
@@ -330,6 +507,85 @@ namespace ns3{
       };
       std::ostream &operator<<( std::ostream & os, ElectSchHeader const & h);
 
+      /* Route Update, sent between cluster heads with the entries changed since the last update.
+       * a head announces only the routes it reaches itself and never relays learned ones, so an update
+       * reaches the adjacent heads only. the metric is 1, or INFINITY_METRIC to withdraw the route.
+       *  0                   1                   2                   3
+       *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |           Rte Count           |
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |                                                               |
+       * |                            prefix                             |
+       * |                                                               |
+       * |                                                               |
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |           Route Tag           | Prefix Length |    Metric     |
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       *   ... Rte Count route table entries
+       */
+      class RouteUpdateHeader: public Header{
+        public:
+          static const uint8_t INFINITY_METRIC= 16; // withdraws the route
+          static const uint32_t RTE_SIZE= 20;
+          struct Rte{
+            Ipv6Address prefix;
+            uint16_t tag;
+            uint8_t prefix_length;
+            uint8_t metric;
+          };
+          RouteUpdateHeader();
+          static TypeId GetTypeId();
+          TypeId GetInstanceTypeId( void) const;
+          uint32_t GetSerializedSize() const;
+          void Serialize( Buffer::Iterator start) const;
+          uint32_t Deserialize( Buffer::Iterator start);
+          void Print( std::ostream &os) const;
+          // serialized size of an update holding no entry
+          static uint32_t GetEmptySize(){ return 2;}
+          void AddRte( Ipv6Address prefix, uint8_t prefix_length, uint8_t metric, uint16_t tag){
+            Rte rte;
+            rte.prefix= prefix;
+            rte.tag= tag;
+            rte.prefix_length= prefix_length;
+            rte.metric= metric;
+            rtes.push_back( rte);
+          }
+          const std::vector< Rte>& GetRtes() const{ return rtes;}
+          size_t GetRteNumber() const{ return rtes.size();}
+
+          bool operator==( RouteUpdateHeader const &o) const;
+        private:
+          std::vector< Rte> rtes;
+      };
+      std::ostream &operator<<( std::ostream & os, RouteUpdateHeader const & h);
+
+      /* Aggregate, several messages of one datagram after a type header of MCIHTYPE_AGGREGATE, one of these before each
+       *  0                   1                   2                   3
+       *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       * |     Type      |            Length             |  Message ...
+       * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       *   length counts the message only, the type is that of a type header
+       */
+      class TlvHeader: public Header{
+        public:
+          TlvHeader( MessageType t= MCIHTYPE_HELLO, uint16_t l= 0);
+          static TypeId GetTypeId();
+          TypeId GetInstanceTypeId( void) const;
+          uint32_t GetSerializedSize() const;
+          void Serialize( Buffer::Iterator start) const;
+          uint32_t Deserialize( Buffer::Iterator start);
+          void Print( std::ostream &os) const;
+          MessageType GetType() const{ return type;}
+          uint16_t GetLength() const{ return length;}
+
+          bool operator==( TlvHeader const &o) const;
+        private:
+          MessageType type;
+          uint16_t length;
+      };
+      std::ostream &operator<<( std::ostream & os, TlvHeader const & h);
 
    }
 }
@@ -0,0 +1,130 @@
+#ifndef __MCIH_PREFIX_TRIE_H_
+#define __MCIH_PREFIX_TRIE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+namespace ns3{
+  namespace mcih{
+    /*
+     * path compressed binary trie on 128 bit prefixes for longest prefix match.
+     * a node holds the values stored under exactly its prefix, nodes without values only branch.
+     */
+    template< typename T> class PrefixTrie{
+      public:
+        static const uint8_t BITS= 128;
+
+        PrefixTrie(): root( new Node( 0)){
+        }
+        // values stored under prefix/length, created empty when missing
+        std::vector< T>& Insert( const uint8_t prefix[ 16], uint8_t length){
+          uint8_t key[ 16];
+          Mask( prefix, length, key);
+          Node *node= root.get();
+          while( node->length< length){
+            std::unique_ptr< Node> &child= node->child[ GetBit( key, node->length)];
+            if( !child){
+              child.reset( new Node( length));
+              memcpy( child->key, key, 16);
+              return child->values;
+            }
+            uint8_t common= std::min( std::min( GetCommonLength( key, child->key), length), child->length);
+            if( common< child->length){
+              // split the edge at the first differing bit
+              std::unique_ptr< Node> branch( new Node( common));
+              Mask( key, common, branch->key);
+              branch->child[ GetBit( child->key, common)]= std::move( child);
+              child= std::move( branch);
+            }
+            node= child.get();
+          }
+          return node->values;
+        }
+        // values stored under exactly prefix/length, 0 when missing
+        std::vector< T>* Find( const uint8_t prefix[ 16], uint8_t length){
+          uint8_t key[ 16];
+          Mask( prefix, length, key);
+          Node *node= root.get();
+          while( node&& node->length< length){
+            node= node->child[ GetBit( key, node->length)].get();
+            if( node&& ( node->length> length|| GetCommonLength( key, node->key)< node->length)) return 0;
+          }
+          return node&& node->length== length? &node->values: 0;
+        }
+        // drops nodes left without values and with less than two children below prefix/length
+        void Compact( const uint8_t prefix[ 16], uint8_t length){
+          uint8_t key[ 16];
+          Mask( prefix, length, key);
+          Compact( root->child[ GetBit( key, 0)], key, length);
+        }
+        // visits the values of every prefix containing address, shortest prefix first
+        template< typename Visit> void Match( const uint8_t address[ 16], Visit visit) const{
+          const Node *node= root.get();
+          while( node){
+            if( GetCommonLength( address, node->key)< node->length) return;
+            if( !node->values.empty()) visit( node->length, node->values);
+            if( node->length== BITS) return;
+            node= node->child[ GetBit( address, node->length)].get();
+          }
+        }
+        template< typename Visit> void ForEach( Visit visit){ ForEach( root.get(), visit);}
+        void Clear(){
+          root.reset( new Node( 0));
+        }
+
+      private:
+        struct Node{
+          uint8_t key[ 16];
+          uint8_t length;
+          std::vector< T> values;
+          std::unique_ptr< Node> child[ 2];
+          Node( uint8_t l): length( l){
+            memset( key, 0, 16);
+          }
+        };
+        std::unique_ptr< Node> root;
+
+        static int GetBit( const uint8_t key[ 16], uint8_t index){
+          return ( key[ index>> 3]>> ( 7- ( index& 7)))& 1;
+        }
+        static uint8_t GetCommonLength( const uint8_t a[ 16], const uint8_t b[ 16]){
+          for( int i= 0; i< 16; i++){
+            uint8_t diff= a[ i]^ b[ i];
+            if( !diff) continue;
+            uint8_t length= i* 8;
+            while( !( diff& 0x80)){
+              diff<<= 1;
+              length++;
+            }
+            return length;
+          }
+          return BITS;
+        }
+        static void Mask( const uint8_t prefix[ 16], uint8_t length, uint8_t key[ 16]){
+          for( int i= 0; i< 16; i++){
+            int bits= length- i* 8;
+            key[ i]= bits>= 8? prefix[ i]: bits<= 0? 0: prefix[ i]& ( uint8_t)( 0xff<< ( 8- bits));
+          }
+        }
+        void Compact( std::unique_ptr< Node> &node, const uint8_t key[ 16], uint8_t length){
+          if( !node|| node->length> length|| GetCommonLength( key, node->key)< node->length) return;
+          if( node->length< length) Compact( node->child[ GetBit( key, node->length)], key, length);
+          if( !node->values.empty()) return;
+          if( node->child[ 0]&& node->child[ 1]) return;
+          std::unique_ptr< Node> rest= std::move( node->child[ node->child[ 0]? 0: 1]);
+          node= std::move( rest);
+        }
+        template< typename Visit> void ForEach( Node *node, Visit &visit){
+          if( !node) return;
+          if( !node->values.empty()) visit( node->values);
+          ForEach( node->child[ 0].get(), visit);
+          ForEach( node->child[ 1].get(), visit);
+        }
+    };
+  }
+}
+
+#endif // __MCIH_PREFIX_TRIE_H_
@@ -1,5 +1,9 @@
 #include "mcih-routing-table.h"
 #include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/ipv6-l3-protocol.h"
+#include "ns3/ipv6-interface.h"
+#include "ns3/ndisc-cache.h"
 #include <iomanip>
 
 using namespace std;
@@ -7,35 +11,395 @@ using namespace std;
 namespace ns3{
   NS_LOG_COMPONENT_DEFINE ("McihRoutingTable");
   namespace mcih{
-    McihRoutingTableEntry::McihRoutingTableEntry(): tag( 0), prefix( 16), status( McihInvalid), changed( false){
+    McihRoutingTableEntry::McihRoutingTableEntry(): tag( 0), prefix( 16), status( McihInvalid), changed( false), version( 0){
     }
     
     McihRoutingTableEntry::McihRoutingTableEntry( Ipv6Address network, Ipv6Prefix prefix, Ipv6Address next_hop, uint32_t if_index, Ipv6Address prefix_to_use): // sub class constructo
       Ipv6RoutingTableEntry( McihRoutingTableEntry::CreateNetworkRouteTo( network, prefix, next_hop, if_index, prefix_to_use)), // super class constructor
-      tag( 0), prefix( 16), status( McihInvalid), changed( false){ // initializer
+      tag( 0), prefix( 16), status( McihInvalid), changed( false), version( 0){ // initializer
     }
 
     McihRoutingTableEntry::McihRoutingTableEntry( Ipv6Address network, Ipv6Prefix prefix, uint32_t if_index): 
       Ipv6RoutingTableEntry( Ipv6RoutingTableEntry::CreateNetworkRouteTo( network, prefix, if_index)), 
-      tag( 0), prefix( 16), status( McihInvalid), changed( false){
+      tag( 0), prefix( 16), status( McihInvalid), changed( false), version( 0){
     }
 
-    McihRoutingTable::McihRoutingTable(){
+    McihRoutingTable::McihRoutingTable(): size( 0), max_routes( 0){
       NS_LOG_FUNCTION( Utility::Coloring( YELLOW, "Mcih Routing Table"));
     }
 
-    Ptr< Ipv6Route> McihRoutingTable::Lookup( Ipv6Address destination, Ptr< NetDevice> device){
-      NS_LOG_FUNCTION( this<< destination<< device);
+    McihRoutingTable::~McihRoutingTable(){
+      Clear();
+    }
+
+    void McihRoutingTable::AddRoute( Ptr< McihRoutingTableEntry> entry, Time lifetime){
+      NS_LOG_FUNCTION( this<< entry<< lifetime);
+      uint8_t bytes[ 16];
+      entry->GetDestNetwork().GetBytes( bytes);
+      vector< Route> &values= routes.Insert( bytes, entry->GetDestNetworkPrefix().GetPrefixLength());
+      for( auto itr= values.begin(); itr!= values.end(); itr++){
+        if( !IsSame( *itr->entry, entry->GetDestNetwork(), entry->GetDestNetworkPrefix(), entry->GetGateway(), entry->GetInterface())) continue;
+        // refreshing in place, routes cached from the entry stay valid unless its state changes
+        NS_LOG_LOGIC( Utility::Coloring( CYAN, "refresh route to ")<< entry->GetDestNetwork());
+        uint32_t version= itr->entry->GetRouteVersion();
+        itr->entry->SetRouteStatus( entry->GetRouteStatus());
+        itr->entry->SetRouteMetric( entry->GetRouteMetric());
+        if( itr->entry->GetRouteVersion()!= version&& !handle_change.IsNull()) handle_change();
+        if( !lifetime.IsStrictlyPositive()){
+          if( itr->recent!= recent.end()){
+            itr->event.Cancel();
+            recent.erase( itr->recent);
+            itr->recent= recent.end();
+            InvalidateCache();
+          }
+          return;
+        }
+        itr->expire_time= Simulator::Now()+ lifetime;
+        if( itr->recent== recent.end()){
+          recent.push_front( itr->entry);
+          itr->recent= recent.begin();
+          InvalidateCache();
+        } else{
+          recent.splice( recent.begin(), recent, itr->recent);
+        }
+        if( !itr->event.IsRunning()) itr->event= Simulator::Schedule( lifetime, &McihRoutingTable::Expire, this, itr->entry);
+        return;
+      }
+
+      Route route;
+      route.entry= entry;
+      route.recent= recent.end();
+      if( lifetime.IsStrictlyPositive()){
+        route.expire_time= Simulator::Now()+ lifetime;
+        recent.push_front( entry);
+        route.recent= recent.begin();
+        route.event= Simulator::Schedule( lifetime, &McihRoutingTable::Expire, this, entry);
+      }
+      values.push_back( route);
+      size++;
+      // a new entry may be a longer match for destinations already cached
+      InvalidateCache();
+      Evict();
+      if( !handle_change.IsNull()) handle_change();
+    }
+
+    bool McihRoutingTable::RemoveRoute( Ipv6Address network, Ipv6Prefix prefix, Ipv6Address gateway, uint32_t if_index){
+      NS_LOG_FUNCTION( this<< network<< prefix<< gateway<< if_index);
+      uint8_t bytes[ 16];
+      network.GetBytes( bytes);
+      vector< Route> *values= routes.Find( bytes, prefix.GetPrefixLength());
+      if( !values) return false;
+      for( auto itr= values->begin(); itr!= values->end(); itr++){
+        if( !IsSame( *itr->entry, network, prefix, gateway, if_index)) continue;
+        Erase( *values, itr);
+        if( values->empty()) routes.Compact( bytes, prefix.GetPrefixLength());
+        return true;
+      }
+      return false;
+    }
+
+    void McihRoutingTable::RemoveRoutes( uint32_t if_index){
+      NS_LOG_FUNCTION( this<< if_index);
+      vector< Ptr< McihRoutingTableEntry> > entries;
+      routes.ForEach( [&]( const vector< Route> &values){
+        for( auto itr= values.begin(); itr!= values.end(); itr++){
+          if( itr->entry->GetInterface()== if_index) entries.push_back( itr->entry);
+        }
+      });
+      for( auto itr= entries.begin(); itr!= entries.end(); itr++){
+        RemoveRoute( ( *itr)->GetDestNetwork(), ( *itr)->GetDestNetworkPrefix(), ( *itr)->GetGateway(), if_index);
+      }
+    }
+
+    void McihRoutingTable::GetRoutes( vector< Ptr< McihRoutingTableEntry> > &entries, bool all){
+      routes.ForEach( [&]( const vector< Route> &values){
+        for( auto itr= values.begin(); itr!= values.end(); itr++){
+          if( itr->entry->GetRouteStatus()!= McihRoutingTableEntry::McihValid) continue;
+          if( all|| itr->entry->IsRouteChanged()) entries.push_back( itr->entry);
+        }
+      });
+    }
+
+    void McihRoutingTable::ClearChanges(){
+      routes.ForEach( [&]( const vector< Route> &values){
+        for( auto itr= values.begin(); itr!= values.end(); itr++) itr->entry->SetRouteChanged( false);
+      });
+      withdrawn.clear();
+    }
+
+    void McihRoutingTable::Clear(){
+      routes.ForEach( [&]( vector< Route> &values){
+        for( auto itr= values.begin(); itr!= values.end(); itr++) itr->event.Cancel();
+      });
+      routes.Clear();
+      recent.clear();
+      withdrawn.clear();
+      size= 0;
+      InvalidateCache();
+    }
+
+    void McihRoutingTable::RefreshInterface( uint32_t if_index){
+      NS_LOG_FUNCTION( this<< if_index);
+      if( !ipv6) throw invalid_argument( "mcih routing table is need to set ipv6");
+      if( interface_addresses.size()<= if_index) interface_addresses.resize( if_index+ 1);
+      InterfaceAddress &addresses= interface_addresses[ if_index];
+      addresses= InterfaceAddress();
+      for( uint32_t ad_index= 0; ad_index< ipv6->GetNAddresses( if_index); ad_index++){
+        auto address= ipv6->GetAddress( if_index, ad_index);
+        if( address.GetScope()== Ipv6InterfaceAddress::LINKLOCAL&& addresses.link_local== Ipv6Address()) addresses.link_local= address.GetAddress();
+        if( address.GetScope()!= Ipv6InterfaceAddress::GLOBAL) continue;
+        if( addresses.global== Ipv6Address()) addresses.global= address.GetAddress();
+        if( preferred_prefix!= Ipv6Address()&& address.GetAddress().CombinePrefix( preferred_mask)== preferred_prefix) addresses.global= address.GetAddress();
+      }
+      if( default_route&& ipv6->GetInterfaceForDevice( default_route->GetOutputDevice())== static_cast< int32_t>( if_index)){
+        default_route->SetSource( GetSourceAddress( if_index, gateway));
+      }
+      BuildHeadRoutes();
+      InvalidateCache();
+    }
+
+    Ipv6Address McihRoutingTable::GetAddress( uint32_t if_index, Ipv6InterfaceAddress::Scope_e scope) const{
+      if( if_index>= interface_addresses.size()) return Ipv6Address();
+      if( scope== Ipv6InterfaceAddress::LINKLOCAL) return interface_addresses[ if_index].link_local;
+      if( scope== Ipv6InterfaceAddress::GLOBAL) return interface_addresses[ if_index].global;
+      return Ipv6Address();
+    }
+
+    Ipv6Address McihRoutingTable::GetSourceAddress( uint32_t if_index, Ipv6Address destination) const{
+      if( if_index>= interface_addresses.size()) return Ipv6Address();
+      const InterfaceAddress &addresses= interface_addresses[ if_index];
+      bool link_scope= destination.IsLinkLocal()|| destination.IsLinkLocalMulticast();
+      Ipv6Address preferred= link_scope? addresses.link_local: addresses.global;
+      return preferred!= Ipv6Address()? preferred: ( link_scope? addresses.global: addresses.link_local);
+    }
+
+    uint32_t McihRoutingTable::FindLinkLocalInterface( Ipv6Address destination) const{
+      // the interface already knowing the neighbor, otherwise the first one able to reach a link
+      auto l3= ipv6->GetObject< Ipv6L3Protocol>();
+      uint32_t fallback= interface_addresses.size();
+      for( uint32_t if_index= 0; if_index< interface_addresses.size(); if_index++){
+        if( interface_addresses[ if_index].link_local== Ipv6Address()|| !l3->IsUp( if_index)) continue;
+        if( fallback== interface_addresses.size()) fallback= if_index;
+        auto ndisc= l3->GetInterface( if_index)->GetNdiscCache();
+        if( ndisc&& ndisc->Lookup( destination)) return if_index;
+      }
+      return fallback;
+    }
+
+    void McihRoutingTable::SetGateway( Ipv6Address gateway, Ipv6Address next_hop, uint32_t if_index){
+      NS_LOG_FUNCTION( this<< gateway<< next_hop<< if_index);
       if( !ipv6) throw invalid_argument( "mcih routing table is need to set ipv6");
+      Ptr< Ipv6Route> route= BuildHeadRoute( gateway, next_hop, if_index);
+      // the new head replaces the old one in a single step, no lookup sees a half built route
+      this->gateway= gateway;
+      default_route= route;
+      BuildHeadRoutes();
+      InvalidateCache();
+    }
+
+    void McihRoutingTable::ClearGateway(){
+      NS_LOG_FUNCTION( this);
+      if( !default_route) return;
+      gateway= Ipv6Address();
+      default_route= 0;
+      BuildHeadRoutes();
+      InvalidateCache();
+    }
+
+    void McihRoutingTable::SetHeads( const vector< Head> &heads){
+      NS_LOG_FUNCTION( this<< heads.size());
+      this->heads= heads;
+      BuildHeadRoutes();
+    }
+
+    void McihRoutingTable::RemoveHead( Ipv6Address address){
+      for( auto itr= heads.begin(); itr!= heads.end(); itr++){
+        if( itr->address!= address) continue;
+        heads.erase( itr);
+        BuildHeadRoutes();
+        return;
+      }
+    }
+
+    Ptr< Ipv6Route> McihRoutingTable::BuildHeadRoute( Ipv6Address head, Ipv6Address next_hop, uint32_t if_index){
+      Ptr< Ipv6Route> route= Create< Ipv6Route>();
+      route->SetSource( GetSourceAddress( if_index, head));
+      route->SetDestination( Ipv6Address::GetAny());
+      route->SetGateway( next_hop);
+      route->SetOutputDevice( ipv6->GetNetDevice( if_index));
+      return route;
+    }
+
+    void McihRoutingTable::BuildHeadRoutes(){
+      head_routes.clear();
+      if( !default_route) return; // members only, and only while registered
+      uint32_t if_index= ipv6->GetInterfaceForDevice( default_route->GetOutputDevice());
+      for( auto itr= heads.begin(); itr!= heads.end(); itr++){
+        if( itr->address== gateway|| itr->next_hop== Ipv6Address()) continue;
+        HeadRoute head_route;
+        head_route.address= itr->address;
+        head_route.route= BuildHeadRoute( itr->address, itr->next_hop, if_index);
+        head_routes.push_back( head_route);
+      }
+    }
+
+    Ptr< Ipv6Route> McihRoutingTable::FindHeadRoute( Ipv6Address head, Ptr< NetDevice> device) const{
+      Ptr< Ipv6Route> route= 0;
+      if( default_route&& head== gateway) route= default_route;
+      for( auto itr= head_routes.begin(); !route&& itr!= head_routes.end(); itr++){
+        if( itr->address== head) route= itr->route;
+      }
+      if( route&& device&& device!= route->GetOutputDevice()) return 0;
+      return route;
+    }
+
+    Ptr< Ipv6Route> McihRoutingTable::SelectHead( Ipv6Address destination, Ptr< NetDevice> device, uint32_t flow){
+      if( !default_route) return 0;
+      if( head_routes.empty()) return FindHeadRoute( gateway, device);
+      FlowKey key;
+      key.destination= destination;
+      key.flow= flow;
+      uint32_t slot= flow_index.Find( key);
+      if( slot!= flow_index.NPOS){
+        Ptr< Ipv6Route> route= FindHeadRoute( flow_heads[ slot], device);
+        if( route) return route;
+      }
+
+      // rendezvous hashing, a new flow goes to the head with the highest weight for it
+      size_t flow_hash= FlowKeyHash()( key);
+      Ptr< Ipv6Route> best= 0;
+      Ipv6Address best_address;
+      uint64_t best_weight= 0;
+      auto consider= [&]( Ipv6Address address, Ptr< Ipv6Route> route){
+        if( device&& device!= route->GetOutputDevice()) return;
+        uint64_t weight= ( flow_hash^ Ipv6AddressHash()( address))* 0xbf58476d1ce4e5b9ULL;
+        weight^= weight>> 31;
+        if( best&& weight<= best_weight) return;
+        best= route;
+        best_address= address;
+        best_weight= weight;
+      };
+      consider( gateway, default_route);
+      for( auto itr= head_routes.begin(); itr!= head_routes.end(); itr++) consider( itr->address, itr->route);
+      if( !best) return best;
+
+      NS_LOG_LOGIC( Utility::Coloring( CYAN, "flow to ")<< destination<< " via head "<< best_address);
+      if( slot!= flow_index.NPOS){
+        flow_heads[ slot]= best_address;
+      } else{
+        if( flow_heads.size()>= FLOW_TABLE_SIZE){
+          flow_index.Clear();
+          flow_heads.clear();
+        }
+        flow_index.Insert( key, flow_heads.size());
+        flow_heads.push_back( best_address);
+      }
+      return best;
+    }
+
+    void McihRoutingTable::SetMaxRoutes( size_t max_routes){
+      this->max_routes= max_routes;
+      Evict();
+    }
+
+    McihRoutingTable::Route* McihRoutingTable::FindRoute( Ptr< McihRoutingTableEntry> entry){
+      uint8_t bytes[ 16];
+      entry->GetDestNetwork().GetBytes( bytes);
+      vector< Route> *values= routes.Find( bytes, entry->GetDestNetworkPrefix().GetPrefixLength());
+      if( !values) return 0;
+      for( auto itr= values->begin(); itr!= values->end(); itr++){
+        if( itr->entry== entry) return &*itr;
+      }
+      return 0;
+    }
+
+    void McihRoutingTable::Erase( vector< Route> &values, vector< Route>::iterator itr){
+      itr->event.Cancel();
+      if( itr->recent!= recent.end()) recent.erase( itr->recent);
+      Ptr< McihRoutingTableEntry> entry= itr->entry;
+      values.erase( itr);
+      size--;
+      InvalidateCache();
+      if( entry->GetRouteStatus()== McihRoutingTableEntry::McihValid){ // kept until the withdrawal is advertised
+        entry->SetRouteStatus( McihRoutingTableEntry::McihInvalid);
+        withdrawn.push_back( entry);
+        if( !handle_change.IsNull()) handle_change();
+      }
+    }
+
+    void McihRoutingTable::Expire( Ptr< McihRoutingTableEntry> entry){
+      Route *route= FindRoute( entry);
+      if( !route) return;
+      if( route->expire_time> Simulator::Now()){ // refreshed since the event was scheduled
+        route->event= Simulator::Schedule( route->expire_time- Simulator::Now(), &McihRoutingTable::Expire, this, entry);
+        return;
+      }
+      NS_LOG_LOGIC( Utility::Coloring( CYAN, "route expired ")<< entry->GetDestNetwork());
+      RemoveRoute( entry->GetDestNetwork(), entry->GetDestNetworkPrefix(), entry->GetGateway(), entry->GetInterface());
+    }
+
+    void McihRoutingTable::Evict(){
+      while( max_routes&& recent.size()> max_routes){
+        Ptr< McihRoutingTableEntry> entry= recent.back();
+        NS_LOG_LOGIC( Utility::Coloring( CYAN, "evict route ")<< entry->GetDestNetwork());
+        RemoveRoute( entry->GetDestNetwork(), entry->GetDestNetworkPrefix(), entry->GetGateway(), entry->GetInterface());
+      }
+    }
+
+    void McihRoutingTable::InvalidateCache(){
+      cache_index.Clear();
+      cache.clear();
+    }
+
+    Ptr< Ipv6Route> McihRoutingTable::Lookup( Ipv6Address destination, Ptr< NetDevice> device, uint32_t flow){
+      NS_LOG_FUNCTION( this<< destination<< device<< flow);
+      if( !ipv6) throw invalid_argument( "mcih routing table is need to set ipv6");
+
+      CacheKey key;
+      key.destination= destination;
+      key.device= device;
+      uint32_t slot= cache_index.Find( key);
+      if( slot!= cache_index.NPOS){
+        const CachedRoute &cached= cache[ slot];
+        if( !cached.entry|| cached.entry->GetRouteVersion()== cached.version){
+          if( cached.recent!= recent.end()) recent.splice( recent.begin(), recent, cached.recent);
+          NS_LOG_LOGIC( Utility::Coloring( CYAN, "cached route via ")<< cached.route->GetGateway());
+          return cached.route;
+        }
+      }
+
+      Ptr< McihRoutingTableEntry> matched= 0;
+      Ptr< Ipv6Route> route_entry= BuildRoute( destination, device, matched);
+      // misses are not cached, a later route may resolve them, and the heads keep their own flow table
+      if( !route_entry) return SelectHead( destination, device, flow);
+
+      CachedRoute cached;
+      cached.route= route_entry;
+      cached.entry= matched;
+      cached.version= matched? matched->GetRouteVersion(): 0;
+      Route *route= matched? FindRoute( matched): 0;
+      cached.recent= route? route->recent: recent.end();
+      if( cached.recent!= recent.end()) recent.splice( recent.begin(), recent, cached.recent);
+      if( slot!= cache_index.NPOS){
+        cache[ slot]= cached;
+      } else{
+        if( cache.size()>= ROUTE_CACHE_SIZE) InvalidateCache();
+        cache_index.Insert( key, cache.size());
+        cache.push_back( cached);
+      }
+      return route_entry;
+    }
+
+    Ptr< Ipv6Route> McihRoutingTable::BuildRoute( Ipv6Address destination, Ptr< NetDevice> device, Ptr< McihRoutingTableEntry> &matched){
+      NS_LOG_FUNCTION( this<< destination<< device);
 
       Ptr< Ipv6Route> route_entry= 0;
-      uint16_t longest_mask= 0;
 
       if( destination.IsLinkLocalMulticast()){
         NS_LOG_LOGIC( Utility::Coloring( CYAN, "routing entry for link local multiacst"));
         NS_ASSERT_MSG( device, "no device");
         route_entry= Create< Ipv6Route>();
-        route_entry->SetSource( ipv6->SourceAddressSelection( ipv6->GetInterfaceForDevice( device), destination));
+        route_entry->SetSource( GetSourceAddress( ipv6->GetInterfaceForDevice( device), destination));
         route_entry->SetGateway( Ipv6Address::GetZero());
         route_entry->SetOutputDevice( device);
         route_entry->SetDestination( destination);
@@ -43,13 +407,15 @@ namespace ns3{
       }
 
       if( destination.IsLinkLocal()){
-      // NS_ASSERT_MSG( device, "no device");
-      //if( !device) device= ipv6->GetNetDevice( 1); 
-      device= ipv6->GetNetDevice( 1); 
+        if( !device){
+          uint32_t if_index= FindLinkLocalInterface( destination);
+          if( if_index>= interface_addresses.size()) return route_entry;
+          device= ipv6->GetNetDevice( if_index);
+        }
 
         NS_LOG_LOGIC( Utility::Coloring( CYAN, "routing entry for link local"));
         route_entry= Create< Ipv6Route>();
-        route_entry->SetSource( ipv6->SourceAddressSelection( ipv6->GetInterfaceForDevice( device), destination));
+        route_entry->SetSource( GetSourceAddress( ipv6->GetInterfaceForDevice( device), destination));
         // route_entry->SetGateway( Ipv6Address::GetAllRoutersMulticast());
         route_entry->SetGateway( destination);
         // route_entry->SetGateway( Ipv6Address::GetZero());
@@ -58,43 +424,40 @@ namespace ns3{
         return route_entry;
       }
 
-      for( auto itr= routes.begin(); itr!= routes.end(); itr++){
-        auto entry= itr->first;
-        if( entry->GetRouteStatus()== McihRoutingTableEntry::McihValid){
-          auto prefix= entry->GetDestNetworkPrefix();
-          auto mask_length= prefix.GetPrefixLength();
-          auto address= entry->GetDestNetwork();
-
-          NS_LOG_LOGIC( string( Utility::Coloring( CYAN, "destination"))<< ": "<< destination<< ", "<< string( Utility::Coloring( CYAN, "mask length"))<< ": "<< mask_length);
-
-          if( prefix.IsMatch( destination, address)){
-            NS_LOG_LOGIC( Utility::Coloring( CYAN, "found global network route ")<< entry);
-            // NS_LOG_LOGIC( entry->GetInterface());
-            if( !device|| device== ipv6->GetNetDevice( entry->GetInterface())){
-            // NS_LOG_LOGIC( Utility::Coloring( RED, "TEST"));
-              if( mask_length< longest_mask){
-                NS_LOG_LOGIC( Utility::Coloring( CYAN, "previous match longer, skpping"));
-                continue;
-              }
-              longest_mask= mask_length;
-
-              auto if_index= entry->GetInterface();
-              route_entry= Create< Ipv6Route>();
-
-              if( entry->GetGateway().IsAny()){
-                route_entry->SetSource( ipv6->SourceAddressSelection( if_index, entry->GetDest()));
-              } else if( entry->GetDest().IsAny()){ // default route
-                route_entry->SetSource( ipv6->SourceAddressSelection( if_index, entry->GetPrefixToUse().IsAny()? destination: entry->GetPrefixToUse()));
-              } else{
-                route_entry->SetSource( ipv6->SourceAddressSelection( if_index, entry->GetDest()));
-              }
-
-              route_entry->SetDestination( entry->GetDest());
-              route_entry->SetGateway( entry->GetGateway());
-              route_entry->SetOutputDevice( ipv6->GetNetDevice( if_index));
-            }
-          }
+      // the trie visits shorter prefixes first, so the last valid entry seen is the longest match,
+      // entries of one prefix are ranked by metric
+      Ptr< McihRoutingTableEntry> best= 0;
+      uint8_t bytes[ 16];
+      destination.GetBytes( bytes);
+      routes.Match( bytes, [&]( uint8_t mask_length, const vector< Route> &matches){
+        NS_LOG_LOGIC( string( Utility::Coloring( CYAN, "destination"))<< ": "<< destination<< ", "<< string( Utility::Coloring( CYAN, "mask length"))<< ": "<< ( uint32_t) mask_length);
+        Ptr< McihRoutingTableEntry> found= 0;
+        for( auto itr= matches.begin(); itr!= matches.end(); itr++){
+          auto entry= itr->entry;
+          if( entry->GetRouteStatus()!= McihRoutingTableEntry::McihValid) continue;
+          if( device&& device!= ipv6->GetNetDevice( entry->GetInterface())) continue;
+          if( found&& found->GetRouteMetric()< entry->GetRouteMetric()) continue;
+          NS_LOG_LOGIC( Utility::Coloring( CYAN, "found global network route ")<< entry);
+          found= entry;
         }
+        if( found) best= found;
+      });
+
+      if( best){
+        auto entry= best;
+        matched= best;
+        auto if_index= entry->GetInterface();
+        route_entry= Create< Ipv6Route>();
+
+        if( entry->GetDest().IsAny()&& !entry->GetPrefixToUse().IsAny()){ // default route bound to a prefix
+          route_entry->SetSource( ipv6->SourceAddressSelection( if_index, entry->GetPrefixToUse()));
+        } else{
+          route_entry->SetSource( GetSourceAddress( if_index, destination));
+        }
+
+        route_entry->SetDestination( entry->GetDest());
+        route_entry->SetGateway( entry->GetGateway());
+        route_entry->SetOutputDevice( ipv6->GetNetDevice( if_index));
       }
       if( route_entry){
         NS_LOG_LOGIC( Utility::Coloring( CYAN, "matching route via")<< route_entry->GetDestination());
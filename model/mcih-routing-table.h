@@ -2,9 +2,11 @@
 #define __MCIH_ROUTING_TABLE_H_
 
 #include <map>
+#include <list>
 
 #include "ns3/object.h"
 #include "ns3/ipv6.h"
+#include "ns3/ipv6-interface-address.h"
 #include "ns3/log.h"
 #include "ns3/ipv6-route.h"
 #include "ns3/timer.h"
@@ -14,8 +16,12 @@
 #include "ns3/ipv6-routing-table-entry.h"
 #include "ns3/ptr.h"
 #include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/callback.h"
 
 #include "mcih-utility.h"
+#include "mcih-prefix-trie.h"
+#include "mcih-slot-index.h"
 
 namespace ns3{
   namespace mcih{
@@ -39,6 +45,7 @@ namespace ns3{
           if( tag!= route_tag){
             tag= route_tag;
             changed= true;
+            version++;
           }
         }
         uint16_t GetRouteTag() const{ return tag;}
@@ -46,6 +53,7 @@ namespace ns3{
           if( prefix!= route_prefix){
             prefix= route_prefix;
             changed= true;
+            version++;
           }
         }
         uint8_t GetRouteMetric() const{ return prefix;}
@@ -53,34 +61,155 @@ namespace ns3{
           if( status!= route_status){
             status= route_status;
             changed= true;
+            version++;
           }
         }
         EntryStatus GetRouteStatus() const{ return status;}
         void SetRouteChanged( bool changed){
           this->changed= changed;
+          if( changed) version++;
         }
         bool IsRouteChanged() const{ return changed;}
+        // bumped whenever the entry is marked changed, cached routes built from an older version are stale
+        uint32_t GetRouteVersion() const{ return version;}
 
       private:
         uint16_t tag;
         uint8_t prefix;
         EntryStatus status;
         bool changed;
+        uint32_t version;
     };
 
     class McihRoutingTable{
       public:
         McihRoutingTable();
-        Ptr< Ipv6Route> Lookup( Ipv6Address destination, Ptr< NetDevice> device= 0);
+        ~McihRoutingTable();
+        // flow tells apart flows to one destination spread over several cluster heads
+        Ptr< Ipv6Route> Lookup( Ipv6Address destination, Ptr< NetDevice> device= 0, uint32_t flow= 0);
         Ptr< McihRoutingTableEntry> entry;
-        void SetIpv6( Ptr< Ipv6> ipv6){ this->ipv6= ipv6;}
-        void SetGateway( Ipv6Address gateway){ this->gateway= gateway;}
+        void SetIpv6( Ptr< Ipv6> ipv6){
+          this->ipv6= ipv6;
+          interface_addresses.clear();
+          InvalidateCache();
+        }
+        // the registered cluster head, reached through next_hop, is the default route until it is cleared or replaced
+        void SetGateway( Ipv6Address gateway, Ipv6Address next_hop, uint32_t if_index);
+        void ClearGateway();
         Ipv6Address GetGateway(){ return gateway;}
-        void AddRoute( Ptr< McihRoutingTableEntry> entry, EventId event){ routes.insert( std::make_pair( entry, event));}
+        struct Head{
+          Ipv6Address address; // global
+          Ipv6Address next_hop; // link local
+        };
+        // other heads on the link of the gateway, traffic falling to the default route is spread over them and the gateway per flow
+        void SetHeads( const std::vector< Head> &heads);
+        void RemoveHead( Ipv6Address address);
+        // an entry equal to one in the table refreshes it, a zero lifetime never expires
+        void AddRoute( Ptr< McihRoutingTableEntry> entry, Time lifetime= Time());
+        bool RemoveRoute( Ipv6Address network, Ipv6Prefix prefix, Ipv6Address gateway, uint32_t if_index);
+        void RemoveRoutes( uint32_t if_index);
+        void Clear();
+        // cap on expiring routes, the least recently used one is evicted beyond it, 0 is unbounded
+        void SetMaxRoutes( size_t max_routes);
+        size_t GetSize() const{ return size;}
+        // called when an entry is added, withdrawn or changes status or metric
+        void SetCallback( Callback< void> cb){ handle_change= cb;}
+        // valid entries, only those marked changed unless all is set, then the entries removed since the last ClearChanges
+        void GetRoutes( std::vector< Ptr< McihRoutingTableEntry> > &entries, bool all);
+        const std::vector< Ptr< McihRoutingTableEntry> >& GetWithdrawnRoutes() const{ return withdrawn;}
+        void ClearChanges();
+        // drops every cached route, called when addresses or interfaces of the node change
+        void InvalidateCache();
+        // reloads the source addresses of an interface, called when its addresses or state change
+        void RefreshInterface( uint32_t if_index);
+        // a global address inside it is preferred as source, Ipv6Address() prefers the first one
+        void SetPreferredPrefix( Ipv6Address prefix, Ipv6Prefix mask){
+          preferred_prefix= prefix;
+          preferred_mask= mask;
+        }
+        // Ipv6Address() when the interface has no address of the scope
+        Ipv6Address GetAddress( uint32_t if_index, Ipv6InterfaceAddress::Scope_e scope) const;
+        // link local for link scope destinations, global otherwise, the other one when the interface lacks it
+        Ipv6Address GetSourceAddress( uint32_t if_index, Ipv6Address destination) const;
       private:
-        std::map< Ptr< McihRoutingTableEntry>, EventId> routes;
+        static const size_t ROUTE_CACHE_SIZE= 1024;
+        static const size_t FLOW_TABLE_SIZE= 1024;
+        struct CacheKey{
+          Ipv6Address destination;
+          Ptr< NetDevice> device;
+          bool operator== ( const CacheKey &target) const{ return destination== target.destination&& device== target.device;}
+        };
+        struct CacheKeyHash{
+          size_t operator()( const CacheKey &key) const{
+            return Ipv6AddressHash()( key.destination)^ ( reinterpret_cast< size_t>( PeekPointer( key.device))>> 4);
+          }
+        };
+        struct FlowKey{
+          Ipv6Address destination;
+          uint32_t flow;
+          bool operator== ( const FlowKey &target) const{ return destination== target.destination&& flow== target.flow;}
+        };
+        struct FlowKeyHash{
+          size_t operator()( const FlowKey &key) const{
+            return Ipv6AddressHash()( key.destination)^ ( key.flow* 0x9e3779b1u);
+          }
+        };
+        struct HeadRoute{
+          Ipv6Address address;
+          Ptr< Ipv6Route> route;
+        };
+        typedef std::list< Ptr< McihRoutingTableEntry> > RecentList;
+        struct CachedRoute{
+          Ptr< Ipv6Route> route;
+          Ptr< McihRoutingTableEntry> entry; // 0 for link local routes
+          uint32_t version; // version of entry when route was built
+          RecentList::iterator recent; // recent.end() for routes without lifetime
+        };
+        struct Route{
+          Ptr< McihRoutingTableEntry> entry;
+          EventId event; // runs at expire_time or earlier, reschedules itself when the route was refreshed
+          Time expire_time;
+          RecentList::iterator recent;
+        };
+        // keyed on destination network and prefix length
+        PrefixTrie< Route> routes;
+        // ready made routes per destination and requested device, valid while their entry keeps its version
+        SlotIndex< CacheKey, CacheKeyHash> cache_index;
+        std::vector< CachedRoute> cache;
+        // expiring routes, most recently added or used first
+        RecentList recent;
+        std::vector< Ptr< McihRoutingTableEntry> > withdrawn;
+        Callback< void> handle_change;
+        size_t size;
+        size_t max_routes;
+        Ptr< Ipv6Route> BuildRoute( Ipv6Address destination, Ptr< NetDevice> device, Ptr< McihRoutingTableEntry> &matched);
+        Route* FindRoute( Ptr< McihRoutingTableEntry> entry);
+        void Erase( std::vector< Route> &values, std::vector< Route>::iterator itr);
+        void Expire( Ptr< McihRoutingTableEntry> entry);
+        void Evict();
+        static bool IsSame( const McihRoutingTableEntry &entry, Ipv6Address network, Ipv6Prefix prefix, Ipv6Address gateway, uint32_t if_index){
+          return entry.GetDestNetwork()== network&& entry.GetDestNetworkPrefix()== prefix&& entry.GetGateway()== gateway&& entry.GetInterface()== if_index;
+        }
         Ptr< Ipv6> ipv6;
         Ipv6Address gateway;
+        struct InterfaceAddress{
+          Ipv6Address link_local;
+          Ipv6Address global;
+        };
+        std::vector< InterfaceAddress> interface_addresses; // source addresses indexed by interface
+        Ipv6Address preferred_prefix;
+        Ipv6Prefix preferred_mask;
+        uint32_t FindLinkLocalInterface( Ipv6Address destination) const;
+        Ptr< Ipv6Route> default_route; // built once per gateway, 0 without one
+        std::vector< Head> heads;
+        std::vector< HeadRoute> head_routes; // built from heads on the interface of the gateway
+        // head each flow was sent to, a flow stays on its head while the head is reachable
+        SlotIndex< FlowKey, FlowKeyHash> flow_index;
+        std::vector< Ipv6Address> flow_heads;
+        Ptr< Ipv6Route> BuildHeadRoute( Ipv6Address head, Ipv6Address next_hop, uint32_t if_index);
+        void BuildHeadRoutes();
+        Ptr< Ipv6Route> FindHeadRoute( Ipv6Address head, Ptr< NetDevice> device) const;
+        Ptr< Ipv6Route> SelectHead( Ipv6Address destination, Ptr< NetDevice> device, uint32_t flow);
     };
   }
 }
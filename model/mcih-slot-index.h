@@ -0,0 +1,101 @@
+#ifndef __MCIH_SLOT_INDEX_H_
+#define __MCIH_SLOT_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3{
+  namespace mcih{
+    /*
+     * open addressing hash index from a key to a slot of a dense array.
+     * linear probing, erased buckets are left as tombstones and swept on rehash.
+     */
+    template< typename Key, typename Hash> class SlotIndex{
+      public:
+        static const uint32_t NPOS= 0xffffffff;
+
+        SlotIndex(): size( 0), used( 0){
+          buckets.resize( MIN_CAPACITY);
+        }
+        uint32_t Find( const Key &key) const{
+          size_t mask= buckets.size()- 1;
+          for( size_t index= hash( key)& mask;; index= ( index+ 1)& mask){
+            const Bucket &bucket= buckets[ index];
+            if( bucket.state== EMPTY) return NPOS;
+            if( bucket.state== FULL&& bucket.key== key) return bucket.slot;
+          }
+        }
+        void Insert( const Key &key, uint32_t slot){
+          if( ( used+ 1)* 2> buckets.size()) Rehash( size* 2< buckets.size()? buckets.size(): buckets.size()* 2);
+          size_t mask= buckets.size()- 1;
+          size_t tombstone= buckets.size();
+          for( size_t index= hash( key)& mask;; index= ( index+ 1)& mask){
+            Bucket &bucket= buckets[ index];
+            if( bucket.state== FULL&& bucket.key== key){
+              bucket.slot= slot;
+              return;
+            }
+            if( bucket.state== DELETED&& tombstone== buckets.size()) tombstone= index;
+            if( bucket.state== EMPTY){
+              if( tombstone== buckets.size()){
+                tombstone= index;
+                used++;
+              }
+              buckets[ tombstone]= Bucket( key, slot, FULL);
+              size++;
+              return;
+            }
+          }
+        }
+        bool Erase( const Key &key){
+          size_t mask= buckets.size()- 1;
+          for( size_t index= hash( key)& mask;; index= ( index+ 1)& mask){
+            Bucket &bucket= buckets[ index];
+            if( bucket.state== EMPTY) return false;
+            if( bucket.state== FULL&& bucket.key== key){
+              bucket.state= DELETED;
+              size--;
+              return true;
+            }
+          }
+        }
+        void Clear(){
+          buckets.assign( MIN_CAPACITY, Bucket());
+          size= 0;
+          used= 0;
+        }
+        size_t Size() const{ return size;}
+
+      private:
+        static const size_t MIN_CAPACITY= 16;
+        enum BucketState{ EMPTY= 0, FULL= 1, DELETED= 2};
+        struct Bucket{
+          Key key;
+          uint32_t slot;
+          uint8_t state;
+          Bucket(): key(), slot( NPOS), state( EMPTY){
+          }
+          Bucket( const Key &k, uint32_t s, uint8_t st): key( k), slot( s), state( st){
+          }
+        };
+        std::vector< Bucket> buckets;
+        size_t size; // number of full buckets
+        size_t used; // number of full and deleted buckets
+        Hash hash;
+
+        void Rehash( size_t capacity){
+          std::vector< Bucket> old;
+          old.swap( buckets);
+          buckets.resize( capacity);
+          size= 0;
+          used= 0;
+          for( auto itr= old.begin(); itr!= old.end(); itr++){
+            if( itr->state== FULL) Insert( itr->key, itr->slot);
+          }
+        }
+    };
+  }
+}
+
+#endif // __MCIH_SLOT_INDEX_H_
@@ -103,7 +103,7 @@ namespace ns3{
 
     Vector GetDistance( Vector a, Vector b);
     double GetEuclidDistance( Vector a, Vector b);
-    template< typename T> T GetMedian( std::vector< T> vec){
+    template< typename T> T GetMedian( const std::vector< T> &vec){
       T t;
       if( !vec.size()) return t;
       int index= vec.size()/ 2;
@@ -7,6 +7,7 @@
 #include <exception>
 #include <algorithm>
 #include <limits>
+#include <cstring>
 
 #include "ns3/wifi-net-device.h"
 #include "ns3/adhoc-wifi-mac.h"
@@ -15,10 +16,13 @@
 #include "ns3/ipv6-interface.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/uinteger.h"
+#include "ns3/boolean.h"
 #include "ns3/ipv6-packet-info-tag.h"
 #include "ns3/abort.h"
 #include "ns3/loopback-net-device.h"
 #include "ns3/udp-header.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/tcp-l4-protocol.h"
 
 #include "mcih.h"
 #include "mcih-utility.h"
@@ -30,6 +34,8 @@ namespace ns3{
   namespace mcih{
     NS_OBJECT_ENSURE_REGISTERED( RoutingProtocol);
     const uint32_t RoutingProtocol::MCIH_PORT= 1701;
+    const uint32_t RoutingProtocol::CONTEXTUAL_ADDRESS_TYPES= 1<< MCIHTYPE_HELLO| 1<< MCIHTYPE_MCHADV| 1<< MCIHTYPE_ELECTMCH
+      | 1<< MCIHTYPE_RGSTREQ| 1<< MCIHTYPE_RGSTREP| 1<< MCIHTYPE_CHRESIGN;
 
     RoutingProtocol::RoutingProtocol():
       ipv6(),
@@ -44,12 +50,17 @@ namespace ns3{
       velocity_check_interval( MilliSeconds( 100)),
       elect_mch_interval( role_check_interval* 2),
       contention_interval( role_check_interval* 4),
+      route_update_interval( Seconds( 15)),
+      min_triggered_delay( Seconds( 1)),
+      max_triggered_delay( Seconds( 5)),
       role_check_timer( Timer::CANCEL_ON_DESTROY),
       velocity_check_timer( Timer::CANCEL_ON_DESTROY),
       elect_mch_timer( Timer::CANCEL_ON_DESTROY),
+      route_update_timer( Timer::CANCEL_ON_DESTROY),
       mcih_routing_table(),
-      neighbor_nodes( hello_interval),
-      neighbor_headers( hello_interval),
+      neighbor_store( hello_interval),
+      neighbor_nodes( neighbor_store),
+      neighbor_headers( neighbor_store),
       cluster_members(),
       interface_exclusions(),
       uniform_random_variable( new UniformRandomVariable),
@@ -57,8 +68,25 @@ namespace ns3{
       velocity( 0, 0, 0),
       initialized( false),
       unbound( 1),
+      max_routes( 0),
+      heads_generation( 0),
+      cluster_prefix_base( "2001:db8:c000::"),
+      cluster_prefix(),
+      cluster_address(),
+      cluster_if_index( 0),
+      cluster_salt( 0),
+      encoding( ENCODING_COMPACT),
+      out_of_compact_range( false),
+      position_origin( 0, 0, 0),
+      contextual_address_types( CONTEXTUAL_ADDRESS_TYPES),
+      hello_keyframe_interval( 10),
+      hellos_since_keyframe( 0),
+      hello_keyframe_sequence( 0),
+      hello_keyframe_needed( true),
+      hello_keyframe_requested( false),
       default_role( Undecided){
         if( ipv6) node= ipv6->GetObject< Node>();
+        neighbor_headers.SetCallback( MakeCallback( &RoutingProtocol::HandleHeaderFailure, this));
         NS_LOG_FUNCTION( Utility::Coloring( CYAN, "mcih construct"));
       }
 
@@ -69,6 +97,8 @@ namespace ns3{
     void RoutingProtocol::NotifyAddAddress( uint32_t if_index, Ipv6InterfaceAddress address){
       NS_LOG_FUNCTION( "interface"<< Utility::Coloring( CYAN, if_index));
       NS_LOG_LOGIC( string( Utility::Coloring( CYAN, Utility::InterfaceAddress( address))));
+      mcih_routing_table.RefreshInterface( if_index); // source addresses of cached routes may change
+      own_addresses.Insert( address.GetAddress(), if_index);
 
       auto l3= ipv6->GetObject< Ipv6L3Protocol>();
       if( l3->IsUp( if_index)){
@@ -109,15 +139,19 @@ namespace ns3{
     }
 
     void RoutingProtocol::NotifyInterfaceDown( uint32_t if_num){
-      NS_LOG_FUNCTION( Utility::Coloring( RED, "not implement yet"));
+      NS_LOG_FUNCTION( this<< if_num);
+      mcih_routing_table.RemoveRoutes( if_num);
+      mcih_routing_table.RefreshInterface( if_num); // link local routes are cached without an entry
     }
 
     void RoutingProtocol::NotifyInterfaceUp( uint32_t if_num){
       NS_LOG_FUNCTION( this<< if_num);
+      mcih_routing_table.RefreshInterface( if_num);
 
       // adding route(ripng)
       for( uint32_t ad_index= 0; ad_index< ipv6->GetNAddresses( if_num); ad_index++){
         auto address= ipv6->GetAddress( if_num, ad_index);
+        own_addresses.Insert( address.GetAddress(), if_num);
         auto network_mask= address.GetPrefix();
         auto network_address= address.GetAddress().CombinePrefix( network_mask);
         if( address!= Ipv6Address()&& network_mask!= Ipv6Prefix()){
@@ -133,7 +167,7 @@ namespace ns3{
       auto ndisc= interface->GetNdiscCache();
       if( ndisc){
         NS_LOG_LOGIC( Utility::Coloring( CYAN, "interface has ndisc cache: ")<< ndisc);
-        neighbor_nodes.AddNdiscCache( ndisc);
+        neighbor_store.AddNdiscCache( ndisc);
       }
 
       if( !initialized){
@@ -145,7 +179,7 @@ namespace ns3{
       if( wifi){
         auto mac= wifi->GetMac();
         if( mac){
-          mac->TraceConnectWithoutContext( "TxErrHeader", neighbor_nodes.GetTxErrorCallback());
+          mac->TraceConnectWithoutContext( "TxErrHeader", neighbor_store.GetTxErrorCallback());
           NS_LOG_LOGIC( Utility::Coloring( CYAN, "set tx error callback"));
         } else{
           NS_LOG_LOGIC( Utility::Coloring( CYAN, "could not get mac address from wifi object"));
@@ -189,17 +223,36 @@ namespace ns3{
     }
 
     void RoutingProtocol::NotifyRemoveAddress( uint32_t if_num, Ipv6InterfaceAddress address){
-      NS_LOG_FUNCTION( Utility::Coloring( RED, "not implement yet"));
+      NS_LOG_FUNCTION( this<< if_num<< address.GetAddress());
+      mcih_routing_table.RefreshInterface( if_num);
+      if( own_addresses.Find( address.GetAddress())== if_num) own_addresses.Erase( address.GetAddress());
+      if( address.GetAddress()!= Ipv6Address()&& address.GetPrefix()!= Ipv6Prefix()){
+        mcih_routing_table.RemoveRoute( address.GetAddress().CombinePrefix( address.GetPrefix()), address.GetPrefix(), Ipv6Address::GetZero(), if_num);
+      }
     }
 
     void RoutingProtocol::NotifyRemoveRoute (Ipv6Address destination, Ipv6Prefix mask, Ipv6Address next_hop, uint32_t if_num, Ipv6Address prefixToUse){
-      NS_LOG_FUNCTION( Utility::Coloring( RED, "not implement yet"));
+      NS_LOG_FUNCTION( this<< destination<< mask<< next_hop<< if_num);
+      mcih_routing_table.RemoveRoute( destination.CombinePrefix( mask), mask, next_hop, if_num);
     }
 
     void RoutingProtocol::PrintRoutingTable( Ptr< OutputStreamWrapper> stream) const{
       NS_LOG_FUNCTION( Utility::Coloring( RED, "not implement yet"));
     }
 
+    // flow label, otherwise a hash of the source, protocol and ports when the packet leads with its transport header.
+    // only forwarded packets surely do, so locally sent traffic without a flow label is spread per destination only
+    static uint32_t GetFlow( Ptr< const Packet> packet, const Ipv6Header &header, bool transport){
+      if( header.GetFlowLabel()) return header.GetFlowLabel();
+      uint8_t protocol= header.GetNextHeader();
+      if( !transport|| !packet|| ( protocol!= UdpL4Protocol::PROT_NUMBER&& protocol!= TcpL4Protocol::PROT_NUMBER)) return 0;
+      uint8_t bytes[ 4];
+      if( packet->CopyData( bytes, sizeof( bytes))< sizeof( bytes)) return 0;
+      uint32_t ports= static_cast< uint32_t>( bytes[ 0])<< 24| bytes[ 1]<< 16| bytes[ 2]<< 8| bytes[ 3];
+      uint32_t flow= ( Ipv6AddressHash()( header.GetSourceAddress())^ protocol)* 0x9e3779b1u;
+      return flow^ ports;
+    }
+
     Ptr< Ipv6Route> RoutingProtocol::RouteOutput( Ptr< Packet> packet, const Ipv6Header &header, Ptr< NetDevice> output_interface, Socket::SocketErrno &sockerr){
       //NS_LOG_FUNCTION( this);
       if( !packet){
@@ -225,7 +278,7 @@ namespace ns3{
         // Print( LOG_LOGIC, GREEN, l3->GetInterface( if_index));
       }
 
-      route_entry= mcih_routing_table.Lookup( destination, output_interface);
+      route_entry= mcih_routing_table.Lookup( destination, output_interface, GetFlow( packet, header, false));
       if( route_entry){
         NS_LOG_INFO( Utility::Coloring( CYAN, "route entry found")<< " - "<<  destination);
         Print( LOG_DEBUG, GREEN, route_entry);
@@ -257,24 +310,33 @@ namespace ns3{
       auto source= header.GetSourceAddress();
 
       if( destination.IsMulticast()){
-        NS_LOG_LOGIC( Utility::Coloring( RED, "route input detects multicast address, but not implement yet"));
-      }
-
-      for( uint32_t if_index = 0; if_index< ipv6->GetNInterfaces(); if_index++){
-        for (uint32_t ad_index= 0; ad_index< ipv6->GetNAddresses( if_index); ad_index++){
-          auto address = ipv6->GetAddress( if_index, ad_index);
-          //Ipv6Address addr = iaddr.GetAddress ();
-          if( address.GetAddress().IsEqual( header.GetDestinationAddress())){
-            if( if_index== if_index_for_device){
-              NS_LOG_LOGIC ("For me (destination " << address << " match)");
-            } else{
-              NS_LOG_LOGIC ("For me (destination " << address << " match) on another interface " << header.GetDestinationAddress ());
-            }
-            local_callback( packet, header, if_index_for_device);
-            return true;
-          }
-          NS_LOG_LOGIC ("Address " << address << " not a match");
+        // a packet copy keeps its uid on every hop, it stands for the sequence number of the source
+        if( IsOwnAddress( source)|| multicast_duplicates.IsDuplicate( source, packet->GetUid())){
+          NS_LOG_LOGIC( Utility::Coloring( CYAN, "drop duplicate multicast from ")<< source);
+          return true;
+        }
+        // Ipv6L3Protocol::Receive already delivered the groups the node joined, this only forwards.
+        // only heads rebroadcast, once per cluster, and link scope never leaves the link
+        if( destination.IsLinkLocalMulticast()|| ( role!= MasterClusterHead&& role!= SubClusterHead)) return true;
+        NS_LOG_LOGIC( Utility::Coloring( CYAN, "rebroadcast multicast to ")<< destination);
+        Ptr< Ipv6MulticastRoute> multicast_route= Create< Ipv6MulticastRoute>();
+        multicast_route->SetGroup( destination);
+        multicast_route->SetOrigin( source);
+        multicast_route->SetParent( if_index_for_device);
+        multicast_route->SetOutputTtl( if_index_for_device, Ipv6MulticastRoute::MAX_TTL- 1);
+        multicast_callback( device, multicast_route, packet, header);
+        return true;
+      }
+
+      uint32_t if_index= own_addresses.Find( destination);
+      if( if_index!= own_addresses.NPOS){
+        if( if_index== if_index_for_device){
+          NS_LOG_LOGIC ("For me (destination " << destination << " match)");
+        } else{
+          NS_LOG_LOGIC ("For me (destination " << destination << " match) on another interface " << if_index);
         }
+        local_callback( packet, header, if_index_for_device);
+        return true;
       }
 
       if( header.GetDestinationAddress().IsLinkLocal()|| header.GetSourceAddress().IsLinkLocal()){
@@ -290,7 +352,7 @@ namespace ns3{
       }
 
       NS_LOG_LOGIC ("Unicast destination");
-      Ptr<Ipv6Route> rtentry = mcih_routing_table.Lookup( header.GetDestinationAddress());
+      Ptr<Ipv6Route> rtentry = mcih_routing_table.Lookup( header.GetDestinationAddress(), 0, GetFlow( packet, header, true));
 
       if( rtentry!= 0){
         NS_LOG_LOGIC ("Found unicast destination - calling unicast callback");
@@ -308,16 +370,7 @@ namespace ns3{
       if( !arg_ipv6) throw invalid_argument( "arg ipv6 is null.");
       if( ipv6) throw invalid_argument( "ipv6 is not null.");
       ipv6= arg_ipv6;
-
-      for( int if_index= 0; if_index< ipv6->GetNInterfaces(); if_index++){
-        auto l3= ipv6->GetObject< Ipv6L3Protocol>();
-        auto interface= l3->GetInterface( if_index);
-        if( interface->IsUp()){
-          NotifyInterfaceUp( if_index);
-        } else{
-          NotifyInterfaceDown( if_index);
-        }
-      }
+      mcih_routing_table.SetIpv6( ipv6);
 
       for( int if_index= 0; if_index< ipv6->GetNInterfaces(); if_index++){
         auto l3= ipv6->GetObject< Ipv6L3Protocol>();
@@ -337,6 +390,31 @@ namespace ns3{
         .SetParent< Ipv6RoutingProtocol>()
         .SetGroupName( "Mcih")
         .AddConstructor< RoutingProtocol>()
+        .AddAttribute( "MaxRoutes", "Cap on expiring routes, the least recently used one is evicted beyond it, 0 is unbounded.",
+            UintegerValue( 0),
+            MakeUintegerAccessor( &RoutingProtocol::max_routes),
+            MakeUintegerChecker< uint32_t>())
+        .AddAttribute( "ClusterPrefix", "The /48 every master cluster head takes a /64 out of for its members to configure addresses from, :: disables it.",
+            Ipv6AddressValue( Ipv6Address( "2001:db8:c000::")),
+            MakeIpv6AddressAccessor( &RoutingProtocol::cluster_prefix_base),
+            MakeIpv6AddressChecker())
+        .AddAttribute( "CompactHeaders", "Send hello, unadv and mchadv in fixed point, raw while the position is over 8 km from PositionOrigin or the speed over 327 m/s. Every encoding is accepted on receive.",
+            BooleanValue( true),
+            MakeBooleanAccessor( &RoutingProtocol::SetCompactHeaders, &RoutingProtocol::GetCompactHeaders),
+            MakeBooleanChecker())
+        .AddAttribute( "PositionOrigin", "Compact positions are relative to it, every node has to use the same one.",
+            VectorValue( Vector( 0, 0, 0)),
+            MakeVectorAccessor( &RoutingProtocol::position_origin),
+            MakeVectorChecker())
+        .AddAttribute( "HelloKeyframeInterval", "Compact hellos between full keyframes, the others carry the changes only, 1 or less sends full hellos only.",
+            UintegerValue( 10),
+            MakeUintegerAccessor( &RoutingProtocol::hello_keyframe_interval),
+            MakeUintegerChecker< uint32_t>())
+        .AddAttribute( "ContextualAddressTypes", "Message types, as bits 1<< type, whose addresses are compressed against the global prefix of the link, the cluster space and the source, "
+            "the others use the stateless forms only. Every form is accepted on receive, the global prefix has to be shared on a link.",
+            UintegerValue( CONTEXTUAL_ADDRESS_TYPES),
+            MakeUintegerAccessor( &RoutingProtocol::contextual_address_types),
+            MakeUintegerChecker< uint32_t>())
         ;   
       return tid;
     }
@@ -347,42 +425,79 @@ namespace ns3{
       return 1;
     }
 
+    Encoding RoutingProtocol::GetMessageEncoding(){
+      bool out_of_range= encoding== ENCODING_COMPACT&& !Quantizer::IsInRange( position_origin, position, velocity);
+      if( out_of_range!= out_of_compact_range){
+        NS_LOG_WARN( Utility::Coloring( RED, out_of_range? "position or velocity out of the compact range, sending raw": "back in the compact range")
+            << " - position "<< position<< ", velocity "<< velocity<< ", origin "<< position_origin);
+        out_of_compact_range= out_of_range;
+      }
+      return out_of_range? ENCODING_RAW: encoding;
+    }
+
     void RoutingProtocol::SendHello( Ipv6Address destination){
       NS_LOG_FUNCTION( Utility::Coloring( MAGENTA, this));
       NS_LOG_DEBUG( Utility::Coloring( CYAN, "destination: ")<< destination);
       if( !destination.IsLinkLocalMulticast())
         throw invalid_argument( "hello is only link local multicast" );
 
-      auto packet= Create< Packet>();
-      SocketIpv6HopLimitTag hoplimit_tag;
-      packet->RemovePacketTag( hoplimit_tag);
-      hoplimit_tag.SetHopLimit( 0);
-      packet->AddPacketTag( hoplimit_tag);
-
-      TypeHeader type( MCIHTYPE_HELLO);
-      HelloHeader hello;
-      hello.SetAddress( GetAddress( 1, Ipv6InterfaceAddress::GLOBAL));
-      hello.SetPosition( position);
-      hello.SetVelocity( velocity);
-      hello.SetRelativePositionAndMobility( GetRPM());
-      hello.SetRelativeStateAndMobility( 0);
-      hello.SetRole( role);
-      hello.SetAbsCm( cluster_members? cluster_members->GetNeighborNumber(): 0);
-      packet->AddHeader( hello);
-      packet->AddHeader( type);
-
       NS_LOG_LOGIC( "ROLE SEND: "<< ToString( role));
 
+      // deltas against the last keyframe, a new one every hello_keyframe_interval hellos, for a new neighbor or when the age overflows
+      Encoding message_encoding= GetMessageEncoding();
+      bool differential= message_encoding== ENCODING_COMPACT&& hello_keyframe_interval> 1;
+      Time age= Simulator::Now()- hello_keyframe_time;
+      bool keyframe= hello_keyframe_needed|| hellos_since_keyframe+ 1>= hello_keyframe_interval|| age> Seconds( Quantizer::AGE_RESOLUTION* 255);
+      if( differential&& keyframe){
+        hello_keyframe_sequence++;
+        hello_keyframe_time= Simulator::Now();
+        hellos_since_keyframe= 0;
+        hello_keyframe_needed= false;
+        age= Time();
+      } else if( differential){
+        hellos_since_keyframe++;
+      }
+
       NS_LOG_LOGIC( Utility::Coloring( CYAN, "socket interface size ")<< socket_interfaces.size());
       for( auto if_itr= socket_interfaces.begin(); if_itr!= socket_interfaces.end(); if_itr++){
         auto socket= if_itr->first;
         auto interface= if_itr->second;
-        auto address= interface->GetLinkLocalAddress();
-        // Print( LOG_LOGIC, CYAN, interface);
-        // socket->SendTo( packet, 0, Inet6SocketAddress( destination, MCIH_PORT));
-        // SendTo( socket, packet, destination);
-        Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+        // the header carries the global address of the interface it leaves from
+        uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+        auto packet= Create< Packet>();
+        SocketIpv6HopLimitTag hoplimit_tag;
+        packet->RemovePacketTag( hoplimit_tag);
+        hoplimit_tag.SetHopLimit( 0);
+        packet->AddPacketTag( hoplimit_tag);
+
+        TypeHeader type( MCIHTYPE_HELLO);
+        HelloHeader hello;
+        hello.SetEncoding( message_encoding);
+        hello.SetOrigin( position_origin);
+        hello.SetAddress( GetAddress( if_index, Ipv6InterfaceAddress::GLOBAL));
+        hello.SetAddressContext( GetAddressContext( if_index), IsContextual( MCIHTYPE_HELLO));
+        hello.SetPosition( position);
+        hello.SetVelocity( velocity);
+        hello.SetRelativePositionAndMobility( GetRPM());
+        hello.SetRelativeStateAndMobility( 0);
+        hello.SetRole( role);
+        hello.SetAbsCm( cluster_members? cluster_members->GetNeighborNumber(): 0);
+        hello.SetKeyframeRequest( hello_keyframe_requested);
+        if( differential){
+          if( hello_keyframes.size()<= if_index) hello_keyframes.resize( if_index+ 1);
+          if( keyframe|| hello_keyframes[ if_index].keyframe!= hello_keyframe_sequence){ // or the interface had none yet
+            hello.SetKeyframe( hello_keyframe_sequence);
+            hello_keyframes[ if_index]= hello.GetState();
+          } else{
+            hello.SetDelta( hello_keyframes[ if_index], static_cast< uint8_t>( age.GetSeconds()/ Quantizer::AGE_RESOLUTION));
+          }
+        }
+        packet->AddHeader( hello);
+        packet->AddHeader( type);
+
+        Queue( socket, packet, destination);
       }
+      hello_keyframe_requested= false;
 
       NS_LOG_INFO( Utility::Coloring( CYAN, "sent hello"));
     }
@@ -402,6 +517,8 @@ namespace ns3{
 
       TypeHeader type( MCIHTYPE_UNADV);
       UnadvHeader unadv;
+      unadv.SetEncoding( GetMessageEncoding());
+      unadv.SetOrigin( position_origin);
       unadv.SetPosition( position);
       unadv.SetVelocity( velocity);
       unadv.SetRelativePositionAndMobility( GetRPM());
@@ -416,7 +533,7 @@ namespace ns3{
         // Print( LOG_LOGIC, CYAN, interface);
         // socket->SendTo( packet, 0, Inet6SocketAddress( destination, MCIH_PORT));
         // SendTo( socket, packet, destination);
-        Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+        Queue( socket, packet, destination);
       }
     }
 
@@ -427,26 +544,29 @@ namespace ns3{
       // if( !destination.IsLinkLocalMulticast()) throw invalid_argument( "destination is only link local multicast for electmch");
       // destination= Ipv6Address::GetAllRoutersMulticast();
 
-      auto packet= Create< Packet>();
-      SocketIpv6HopLimitTag hoplimit_tag;
-      packet->RemovePacketTag( hoplimit_tag);
-      hoplimit_tag.SetHopLimit( 0);
-      packet->AddPacketTag( hoplimit_tag);
-
-      TypeHeader type( MCIHTYPE_ELECTMCH);
-      ElectMchHeader electmch;
-      electmch.SetTargetAddress( neighbor_nodes.GetLowestRpmNeighborAddress());
-      packet->AddHeader( electmch);
-      packet->AddHeader( type);
-
+      auto target= neighbor_nodes.GetLowestRpmNeighborAddress();
 
       NS_LOG_FUNCTION( Utility::Coloring( CYAN, "socket interface size ")<< socket_interfaces.size());
       for( auto if_itr= socket_interfaces.begin(); if_itr!= socket_interfaces.end(); if_itr++){
         auto socket= if_itr->first;
         auto interface= if_itr->second;
         Print( LOG_DEBUG, CYAN, interface);
+        uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+        auto packet= Create< Packet>();
+        SocketIpv6HopLimitTag hoplimit_tag;
+        packet->RemovePacketTag( hoplimit_tag);
+        hoplimit_tag.SetHopLimit( 0);
+        packet->AddPacketTag( hoplimit_tag);
+
+        TypeHeader type( MCIHTYPE_ELECTMCH);
+        ElectMchHeader electmch;
+        electmch.SetTargetAddress( target);
+        electmch.SetAddressContext( GetAddressContext( if_index), IsContextual( MCIHTYPE_ELECTMCH));
+        packet->AddHeader( electmch);
+        packet->AddHeader( type);
+
         // SendTo( socket, packet, destination);
-        Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+        Queue( socket, packet, destination);
       }
     }
 
@@ -455,60 +575,58 @@ namespace ns3{
       NS_LOG_DEBUG( Utility::Coloring( CYAN, "destination: ")<< destination);
       if( !destination.IsLinkLocalMulticast()) throw invalid_argument( "undecided advertisement is only link local multicast" );
 
-      auto packet= Create< Packet>();
-      SocketIpv6HopLimitTag hoplimit_tag;
-      packet->RemovePacketTag( hoplimit_tag);
-      hoplimit_tag.SetHopLimit( 0);
-      packet->AddPacketTag( hoplimit_tag);
-
-      TypeHeader type( MCIHTYPE_MCHADV);
-      MchadvHeader mchadv;
-      mchadv.SetPosition( position);
-      mchadv.SetVelocity( velocity);
-      mchadv.SetRelativePositionAndMobility( GetRPM());
-      mchadv.SetMchAddress( GetAddress( 1, Ipv6InterfaceAddress::GLOBAL));
-      packet->AddHeader( mchadv);
-      packet->AddHeader( type);
-
       NS_LOG_FUNCTION( Utility::Coloring( CYAN, "socket interface size ")<< socket_interfaces.size());
       for( auto if_itr= socket_interfaces.begin(); if_itr!= socket_interfaces.end(); if_itr++){
         auto socket= if_itr->first;
         auto interface= if_itr->second;
-        auto address= interface->GetLinkLocalAddress();
-        // Print( LOG_LOGIC, CYAN, interface);
-        // socket->SendTo( packet, 0, Inet6SocketAddress( destination, MCIH_PORT));
-        // SendTo( socket, packet, destination);
-        Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+        uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+        auto packet= Create< Packet>();
+        SocketIpv6HopLimitTag hoplimit_tag;
+        packet->RemovePacketTag( hoplimit_tag);
+        hoplimit_tag.SetHopLimit( 0);
+        packet->AddPacketTag( hoplimit_tag);
+
+        TypeHeader type( MCIHTYPE_MCHADV);
+        MchadvHeader mchadv;
+        mchadv.SetEncoding( GetMessageEncoding());
+        mchadv.SetOrigin( position_origin);
+        mchadv.SetPosition( position);
+        mchadv.SetVelocity( velocity);
+        mchadv.SetRelativePositionAndMobility( GetRPM());
+        mchadv.SetMchAddress( GetAddress( if_index, Ipv6InterfaceAddress::GLOBAL));
+        mchadv.SetAddressContext( GetAddressContext( if_index), IsContextual( MCIHTYPE_MCHADV));
+        packet->AddHeader( mchadv);
+        packet->AddHeader( type);
+
+        Queue( socket, packet, destination);
       }
     }
 
-    void RoutingProtocol::SendRgstreq( Ipv6Address destination){
+    void RoutingProtocol::SendRgstreq( Ipv6Address destination, Ipv6Address target){
       NS_LOG_FUNCTION( Utility::Coloring( MAGENTA, this));
       NS_LOG_DEBUG( Utility::Coloring( CYAN, "destination: ")<< destination);
       // if( !destination.IsLinkLocalMulticast()) throw invalid_argument( "registration request is only link local multicast" );
 
-      auto packet= Create< Packet>();
-      SocketIpv6HopLimitTag hoplimit_tag;
-      packet->RemovePacketTag( hoplimit_tag);
-      hoplimit_tag.SetHopLimit( 0);
-      packet->AddPacketTag( hoplimit_tag);
-
-      TypeHeader type( MCIHTYPE_RGSTREQ);
-      RgstreqHeader header;
-      header.SetTargetAddress( neighbor_headers.GetLowestRpmNeighborAddress());
-      header.SetRegistAddress( GetAddress( 1, Ipv6InterfaceAddress::GLOBAL));
-      packet->AddHeader( header);
-      packet->AddHeader( type);
-
       NS_LOG_LOGIC( Utility::Coloring( CYAN, "socket interface size ")<< socket_interfaces.size());
       for( auto if_itr= socket_interfaces.begin(); if_itr!= socket_interfaces.end(); if_itr++){
         auto socket= if_itr->first;
         auto interface= if_itr->second;
-        auto address= interface->GetLinkLocalAddress();
-        // Print( LOG_LOGIC, CYAN, interface);
-        // socket->SendTo( packet, 0, Inet6SocketAddress( destination, MCIH_PORT));
-        // SendTo( socket, packet, destination);
-        Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+        uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+        auto packet= Create< Packet>();
+        SocketIpv6HopLimitTag hoplimit_tag;
+        packet->RemovePacketTag( hoplimit_tag);
+        hoplimit_tag.SetHopLimit( 0);
+        packet->AddPacketTag( hoplimit_tag);
+
+        TypeHeader type( MCIHTYPE_RGSTREQ);
+        RgstreqHeader header;
+        header.SetTargetAddress( target);
+        header.SetRegistAddress( GetAddress( if_index, Ipv6InterfaceAddress::GLOBAL));
+        header.SetAddressContext( GetAddressContext( if_index), IsContextual( MCIHTYPE_RGSTREQ));
+        packet->AddHeader( header);
+        packet->AddHeader( type);
+
+        Queue( socket, packet, destination);
       }
     }
 
@@ -518,27 +636,26 @@ namespace ns3{
       NS_LOG_DEBUG( Utility::Coloring( CYAN, "destination: ")<< destination);
       // if( !destination.IsLinkLocalMulticast()) throw invalid_argument( "registration request is only link local multicast" );
 
-      auto packet= Create< Packet>();
-      SocketIpv6HopLimitTag hoplimit_tag;
-      packet->RemovePacketTag( hoplimit_tag);
-      hoplimit_tag.SetHopLimit( 0);
-      packet->AddPacketTag( hoplimit_tag);
-
-      TypeHeader type( MCIHTYPE_RGSTREP);
-      RgstrepHeader header;
-      header.SetHeaderAddress( GetAddress( 1, Ipv6InterfaceAddress::GLOBAL));// neighbor_headers.GetLowestRpmNeighborAddress());
-      packet->AddHeader( header);
-      packet->AddHeader( type);
-
       NS_LOG_LOGIC( Utility::Coloring( CYAN, "socket interface size ")<< socket_interfaces.size());
       for( auto if_itr= socket_interfaces.begin(); if_itr!= socket_interfaces.end(); if_itr++){
         auto socket= if_itr->first;
         auto interface= if_itr->second;
-        auto address= interface->GetLinkLocalAddress();
-        // Print( LOG_LOGIC, CYAN, interface);
-        // socket->SendTo( packet, 0, Inet6SocketAddress( destination, MCIH_PORT));
-        // SendTo( socket, packet, destination);
-        Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+        uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+        auto packet= Create< Packet>();
+        SocketIpv6HopLimitTag hoplimit_tag;
+        packet->RemovePacketTag( hoplimit_tag);
+        hoplimit_tag.SetHopLimit( 0);
+        packet->AddPacketTag( hoplimit_tag);
+
+        TypeHeader type( MCIHTYPE_RGSTREP);
+        RgstrepHeader header;
+        header.SetHeaderAddress( GetAddress( if_index, Ipv6InterfaceAddress::GLOBAL));// neighbor_headers.GetLowestRpmNeighborAddress());
+        header.SetClusterPrefix( cluster_prefix);
+        header.SetAddressContext( GetAddressContext( if_index), IsContextual( MCIHTYPE_RGSTREP));
+        packet->AddHeader( header);
+        packet->AddHeader( type);
+
+        Queue( socket, packet, destination);
       }
     }
 
@@ -547,26 +664,27 @@ namespace ns3{
       NS_LOG_DEBUG( Utility::Coloring( CYAN, "destination: ")<< destination);
       // if( !destination.IsLinkLocalMulticast()) throw invalid_argument( "registration request is only link local multicast" );
 
-      auto packet= Create< Packet>();
-      SocketIpv6HopLimitTag hoplimit_tag;
-      packet->RemovePacketTag( hoplimit_tag);
-      hoplimit_tag.SetHopLimit( 0);
-      packet->AddPacketTag( hoplimit_tag);
-
-      TypeHeader type( MCIHTYPE_CHRESIGN);
-      ResignHeader header;
-      packet->AddHeader( header);
-      packet->AddHeader( type);
-
       NS_LOG_LOGIC( Utility::Coloring( CYAN, "socket interface size ")<< socket_interfaces.size());
       for( auto if_itr= socket_interfaces.begin(); if_itr!= socket_interfaces.end(); if_itr++){
         auto socket= if_itr->first;
         auto interface= if_itr->second;
-        auto address= interface->GetLinkLocalAddress();
-        // Print( LOG_LOGIC, CYAN, interface);
-        // socket->SendTo( packet, 0, Inet6SocketAddress( destination, MCIH_PORT));
+        uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+        auto packet= Create< Packet>();
+        SocketIpv6HopLimitTag hoplimit_tag;
+        packet->RemovePacketTag( hoplimit_tag);
+        hoplimit_tag.SetHopLimit( 0);
+        packet->AddPacketTag( hoplimit_tag);
+
+        // names the resigning node, members and heads are kept under their global address
+        TypeHeader type( MCIHTYPE_CHRESIGN);
+        ResignHeader header;
+        header.SetHeaderAddress( GetAddress( if_index, Ipv6InterfaceAddress::GLOBAL));
+        header.SetAddressContext( GetAddressContext( if_index), IsContextual( MCIHTYPE_CHRESIGN));
+        packet->AddHeader( header);
+        packet->AddHeader( type);
+
         // SendTo( socket, packet, destination);
-        Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+        Queue( socket, packet, destination);
       }
       SetRole( Undecided);
     }
@@ -584,8 +702,12 @@ namespace ns3{
       }
 
       if( r== Undecided){
-        neighbor_headers.SetOwnClusterHead( Ipv6Address::GetAny());
+        neighbor_headers.ClearOwnClusterHead();
       }
+      if( r!= ClusterMember){ // only members forward through their head
+        mcih_routing_table.ClearGateway();
+      }
+      LeaveClusterPrefix();
 
       switch( role){
         case Undecided:
@@ -595,7 +717,7 @@ namespace ns3{
           } else if( r== MasterClusterHead){
             NS_LOG_LOGIC( Utility::Coloring( CYAN, "undecided -> master cluster head"));
             if( !cluster_members)
-              cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( hello_interval));
+              cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( neighbor_store));
             EmptyCheckUpdate( contention_interval);
           } else throw invalid_argument( "invalid updating role to without cluster member from undecided");
           break;
@@ -611,7 +733,7 @@ namespace ns3{
           } else if( r==MasterClusterHead){
             NS_LOG_LOGIC( Utility::Coloring( CYAN, "cluster member -> master cluster head"));
             if( !cluster_members)
-              cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( hello_interval));
+              cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( neighbor_store));
             EmptyCheckUpdate( contention_interval);
             NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "not implement yet"));
           } else throw invalid_argument( "invalid role");
@@ -628,7 +750,7 @@ namespace ns3{
           } else if( r== MasterClusterHead){
             NS_LOG_LOGIC( Utility::Coloring( CYAN, "sub cluster head -> master cluster head"));
             if( !cluster_members)
-              cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( hello_interval));
+              cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( neighbor_store));
             EmptyCheckUpdate( contention_interval);
             NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "not implement yet"));
           } else throw invalid_argument( "invalid role");
@@ -650,6 +772,14 @@ namespace ns3{
           break;
       }
       role= r;
+
+      if( r== MasterClusterHead&& cluster_prefix_base!= Ipv6Address()&& !socket_interfaces.empty()){
+        uint32_t if_index= numeric_limits< uint32_t>::max();
+        for( auto itr= socket_interfaces.begin(); itr!= socket_interfaces.end(); itr++){
+          if_index= min< uint32_t>( if_index, ipv6->GetInterfaceForDevice( itr->second->GetDevice()));
+        }
+        JoinClusterPrefix( MakeClusterPrefix( if_index), if_index, Ipv6Prefix( CLUSTER_PREFIX_LENGTH));
+      }
     }
 
     void RoutingProtocol::SetDefaultRole( Role r){
@@ -660,7 +790,7 @@ namespace ns3{
     void RoutingProtocol::Start(){
       NS_LOG_FUNCTION( Utility::Coloring( CYAN, "node launch"));
       if( !ipv6) throw invalid_argument( "need ipv6 pointer");
-      mcih_routing_table.SetIpv6( ipv6);
+      mcih_routing_table.SetMaxRoutes( max_routes);
       role_check_timer.SetFunction( &RoutingProtocol::RoleCheckTimerExpire, this);
       role_check_timer.Schedule( role_check_interval);
       velocity_check_timer.SetFunction( &RoutingProtocol::VelocityCheckTimerExpire, this);
@@ -668,6 +798,9 @@ namespace ns3{
       elect_mch_timer.SetFunction( &RoutingProtocol::ElectMchTimerExpire, this);
       ElectMchUpdate(elect_mch_interval);
       empty_check_timer.SetFunction( &RoutingProtocol::EmptyCheckTimerExpire, this);
+      mcih_routing_table.SetCallback( MakeCallback( &RoutingProtocol::SendTriggeredRouteUpdate, this));
+      route_update_timer.SetFunction( &RoutingProtocol::RouteUpdateTimerExpire, this);
+      route_update_timer.Schedule( route_update_interval);
       // role= default_role;
       // if( role== MasterClusterHead){ EmptyCheckUpdate( contention_interval); }
     }
@@ -726,85 +859,145 @@ namespace ns3{
       // NS_LOG_LOGIC( Utility::Coloring( CYAN, "removed packet information tag"));
       // NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "comment out for debug"));
 
+      // tags are peeked and the message read straight from the buffer, until it is known to be wanted
+      SocketAddressTag tag;
+      if( !packet->PeekPacketTag( tag)){
+        NS_ABORT_MSG( "sender address can not detection, aborting");
+      }
+      auto sender_address= Inet6SocketAddress::ConvertFrom( tag.GetAddress()).GetIpv6();
+      if( IsOwnAddress( sender_address)){
+        NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "ignoring a packet sent by myself"));
+        return;
+      }
+
+      uint8_t buffer[ PEEK_SIZE];
+      uint32_t size= packet->CopyData( buffer, PEEK_SIZE);
+      if( !size) return;
+      if( buffer[ 0]!= MCIHTYPE_AGGREGATE&& !Accept( buffer[ 0], buffer+ 1, size- 1, sender_address)){
+        NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "rejected message of type ")<< ( uint32_t) buffer[ 0]<< " from "<< sender_address);
+        return;
+      }
+
       auto interface= FindReceiveInterface( socket);
       if( !interface){
         throw invalid_argument( "unknown interface is set in receive callback");
       }
-      auto device= interface->GetDevice();
 
       SocketIpv6HopLimitTag hoplimit_tag;
-      if( !packet->RemovePacketTag( hoplimit_tag)){
+      if( !packet->PeekPacketTag( hoplimit_tag)){
         NS_ABORT_MSG ("No incoming Hop Count on RIPng message, aborting.");
       }
       uint8_t hoplimit= hoplimit_tag.GetHopLimit();
-      // NS_LOG_LOGIC( Utility::Coloring( CYAN, "removed hoplimit tag"));
-
-      SocketAddressTag tag;
-      if( !packet->RemovePacketTag( tag)){
-        NS_ABORT_MSG( "sender address can not detection, aborting");
-      }
-      auto addr= Inet6SocketAddress::ConvertFrom( tag.GetAddress ());
-      NS_LOG_LOGIC( string( Utility::Coloring( CYAN, "received one packet from "))<< addr.GetIpv6()<< ", "
+      NS_LOG_LOGIC( string( Utility::Coloring( CYAN, "received one packet from "))<< sender_address<< ", "
           << string( Utility::Coloring( CYAN, "own ip address "))<< interface->GetLinkLocalAddress().GetAddress());
-      // NS_LOG_LOGIC( Utility::Coloring( CYAN, "removed packet tag"));
 
-      auto sender_address= Inet6SocketAddress::ConvertFrom( tag.GetAddress()).GetIpv6();
-      uint16_t sender_port= Inet6SocketAddress::ConvertFrom( tag.GetAddress()).GetPort();
-      int32_t interface_for_address = ipv6->GetInterfaceForAddress( sender_address);
-      if( interface_for_address!= -1){
-        NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "ignoring a packet sent by myself"));
+      if( buffer[ 0]!= MCIHTYPE_AGGREGATE){
+        packet->RemoveAtStart( TypeHeader().GetSerializedSize());
+        Dispatch( MessageType( buffer[ 0]), packet, sender_address, interface, hoplimit);
         return;
       }
+      // messages sent in the same tick, each one is handled as if it came alone
+      packet->RemoveAtStart( TypeHeader().GetSerializedSize());
+      const uint32_t tlv_size= TlvHeader().GetSerializedSize();
+      while( ( size= packet->CopyData( buffer, PEEK_SIZE))>= tlv_size){
+        uint16_t length= buffer[ 1]<< 8| buffer[ 2];
+        if( length> packet->GetSize()- tlv_size){
+          NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "truncated aggregate from ")<< sender_address);
+          return;
+        }
+        if( Accept( buffer[ 0], buffer+ tlv_size, std::min< uint32_t>( size- tlv_size, length), sender_address)){
+          Dispatch( MessageType( buffer[ 0]), packet->CreateFragment( tlv_size, length), sender_address, interface, hoplimit);
+        }
+        packet->RemoveAtStart( tlv_size+ length);
+      }
+    }
 
-      TypeHeader header;
-      if( !packet->RemoveHeader( header)){
-        NS_ABORT_MSG( "no mcih type header, invalid packet");
+    bool RoutingProtocol::Accept( uint8_t type, const uint8_t *body, uint32_t size, Ipv6Address source){
+      switch( type){
+        case MCIHTYPE_RGSTREQ: // the target leads the body as in elect mch
+          if( role!= MasterClusterHead&& role!= SubClusterHead) return false;
+          return IsOwnTarget( body, size, source);
+        case MCIHTYPE_ELECTMCH:
+          return IsOwnTarget( body, size, source);
+        case MCIHTYPE_RTUPDATE:
+          return role== MasterClusterHead|| role== SubClusterHead;
+        default:
+          return type< MCIHTYPE_AGGREGATE;
       }
-      // NS_LOG_LOGIC( Utility::Coloring( CYAN, "removed type header, header type ")<< header.GetType());
+    }
 
-      if( header.IsValid()){
-        switch( header.GetType()){
-          case MCIHTYPE_HELLO:
-            ReceiveHello( packet, sender_address, interface, hoplimit);
-            break;
-          case MCIHTYPE_MCHADV:
-            ReceiveMchadv( packet, sender_address, interface, hoplimit);
-            break;
-          case MCIHTYPE_SCHADV:
-            NS_LOG_FUNCTION( Utility::Coloring( RED, "action for receiving schadv header is not implement yet"));
-            break;
-          case MCIHTYPE_CMADV:
-            NS_LOG_FUNCTION( Utility::Coloring( RED, "action for receiving cmadv header is not implement yet"));
-            break;
-          case MCIHTYPE_UNADV:
-            ReceiveUnadv( packet, sender_address, interface, hoplimit);
-            break;
-          case MCIHTYPE_ELECTMCH:
-            ReceiveElectMch( packet, sender_address, interface, hoplimit);
-            break;
-          case MCIHTYPE_RGSTREQ:
-            if( role== MasterClusterHead|| role== SubClusterHead) ReceiveRgstreq( packet, sender_address, interface, hoplimit);
-            break;
-          case MCIHTYPE_RGSTREP:
-            ReceiveRgstrep( packet, sender_address, interface, hoplimit);
-            break;
-          case MCIHTYPE_CHRESIGN:
-            ReceiveResign( packet, sender_address, interface, hoplimit);
-            break;
-          default:
-            NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "ignoring message with unknown type ")<< header.GetType());
-        }
+    bool RoutingProtocol::IsOwnTarget( const uint8_t *body, uint32_t size, Ipv6Address source){
+      if( !size) return false;
+      uint8_t mode= body[ 0]>> 4;
+      if( size< 1+ AddressCompressor::GetSize( mode)) return false;
+      // the global prefix of the link is only known with the receive interface, the handler checks those
+      if( ( mode& 0xc)== AddressCompressor::PREFIX_LINK) return true;
+      AddressContext context;
+      context.source= source;
+      if( cluster_prefix_base!= Ipv6Address()) context.cluster_space= cluster_prefix_base.CombinePrefix( Ipv6Prefix( CLUSTER_SPACE_LENGTH));
+      return IsOwnAddress( AddressCompressor::Decode( body+ 1, mode, context));
+    }
+
+    void RoutingProtocol::Dispatch( MessageType type, Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit){
+      switch( type){
+        case MCIHTYPE_HELLO:
+          ReceiveHello( packet, source, interface, hoplimit);
+          break;
+        case MCIHTYPE_MCHADV:
+          ReceiveMchadv( packet, source, interface, hoplimit);
+          break;
+        case MCIHTYPE_SCHADV:
+          NS_LOG_FUNCTION( Utility::Coloring( RED, "action for receiving schadv header is not implement yet"));
+          break;
+        case MCIHTYPE_CMADV:
+          NS_LOG_FUNCTION( Utility::Coloring( RED, "action for receiving cmadv header is not implement yet"));
+          break;
+        case MCIHTYPE_UNADV:
+          ReceiveUnadv( packet, source, interface, hoplimit);
+          break;
+        case MCIHTYPE_ELECTMCH:
+          ReceiveElectMch( packet, source, interface, hoplimit);
+          break;
+        case MCIHTYPE_RGSTREQ:
+          if( role== MasterClusterHead|| role== SubClusterHead) ReceiveRgstreq( packet, source, interface, hoplimit);
+          break;
+        case MCIHTYPE_RGSTREP:
+          ReceiveRgstrep( packet, source, interface, hoplimit);
+          break;
+        case MCIHTYPE_CHRESIGN:
+          ReceiveResign( packet, source, interface, hoplimit);
+          break;
+        case MCIHTYPE_RTUPDATE:
+          if( role== MasterClusterHead|| role== SubClusterHead) ReceiveRouteUpdate( packet, source, interface, hoplimit);
+          break;
+        default:
+          NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "ignoring message with unknown type ")<< type);
       }
-      return;
     }
 
     void RoutingProtocol::ReceiveHello( Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit){
       NS_LOG_FUNCTION( this<< source);
 
       HelloHeader header;
+      header.SetOrigin( position_origin);
+      header.SetAddressContext( GetAddressContext( ipv6->GetInterfaceForDevice( interface->GetDevice()), source));
       if( !packet->RemoveHeader( header)){
         NS_ABORT_MSG( "packet has no hello header");
       }
+      if( !header.IsValid()){
+        NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "dropping hello of an unknown encoding from ")<< source);
+        return;
+      }
+      auto known= neighbor_store.Find( NeighborStore::NODE, source);
+      if( !known) hello_keyframe_needed= true; // the new neighbor can not read our deltas yet
+      if( header.GetKeyframeRequest()) hello_keyframe_needed= true; // a neighbor lost our keyframe
+      if( header.GetEncoding()== ENCODING_DELTA&& ( !known|| !known->has_keyframe|| !header.Resolve( known->hello_keyframe))){
+        NS_LOG_LOGIC( "dropping delta hello without its keyframe from "<< source);
+        // the sender is still there, only its state waits for the keyframe asked in our next hello
+        if( known) neighbor_store.Touch( *known, active_neighbor_timeout);
+        hello_keyframe_requested= true;
+        return;
+      }
 
       Ipv6Address addr= header.GetAddress();
       Vector pos= header.GetPosition();
@@ -814,13 +1007,14 @@ namespace ns3{
       Role role= header.GetRole();
       NS_LOG_LOGIC( "ROLE RECEIVE: "<< ToString( role));
 
-      neighbor_nodes.Update( source, active_neighbor_timeout, header);
-      if( cluster_members){
-        cluster_members->Update( addr, active_neighbor_timeout, header);
+      // one record for the sender, refreshed in every view it belongs to
+      auto &entry= neighbor_store.Update( source, active_neighbor_timeout, header);
+      if( header.GetEncoding()== ENCODING_KEYFRAME){
+        entry.hello_keyframe= header.GetState();
+        entry.has_keyframe= true;
       }
-
       if( role== MasterClusterHead|| role== SubClusterHead){
-        neighbor_headers.Update( addr, active_neighbor_timeout, header, pos, vel);
+        neighbor_headers.Update( entry, pos, vel);
       }
 
       if( role== MasterClusterHead|| role== SubClusterHead){
@@ -829,7 +1023,9 @@ namespace ns3{
 
       //  bool AddRoute( Ptr< NetDevice> device, Ipv6Address destination, Ipv6Address gateway, Ipv6InterfaceAddress interface, RouteFlags flag, Time lifetime);
       NS_ASSERT_MSG( source.IsLinkLocal(), "unadv packet comes from not link local address: "<< source);
-      // routing_table.AddRoute( interface->GetDevice(), source, Ipv6Address::GetAllNodesMulticast(), interface->GetLinkLocalAddress(), VALID, active_route_timeout);
+      if( addr!= Ipv6Address()){ // the neighbor stays reachable on link while its hellos keep coming
+        AddHostRouteTo( addr, source, ipv6->GetInterfaceForDevice( interface->GetDevice()));
+      }
 
       Print( LOG_LEVEL_DEBUG, GREEN, pos);
       Print( LOG_LEVEL_DEBUG, GREEN, vel);
@@ -842,9 +1038,14 @@ namespace ns3{
       //NS_LOG_LOGIC( Utility::Coloring( CYAN, "receive from ")<< source);
 
       UnadvHeader header;
+      header.SetOrigin( position_origin);
       if( !packet->RemoveHeader( header)){
         NS_ABORT_MSG( "packet has no unadv header");
       }
+      if( !header.IsValid()){
+        NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "dropping unadv of an unknown encoding from ")<< source);
+        return;
+      }
       neighbor_nodes.Update( source, active_neighbor_timeout, header);
 
       Vector pos= header.GetPosition();
@@ -866,6 +1067,7 @@ namespace ns3{
       //NS_LOG_LOGIC( Utility::Coloring( CYAN, "receive from ")<< source);
 
       ElectMchHeader header;
+      header.SetAddressContext( GetAddressContext( ipv6->GetInterfaceForDevice( interface->GetDevice()), source));
       if( !packet->RemoveHeader( header)){
         NS_ABORT_MSG( "packet has no elect mch header");
       }
@@ -882,9 +1084,15 @@ namespace ns3{
       NS_LOG_FUNCTION( this<< source);
 
       MchadvHeader header;
+      header.SetOrigin( position_origin);
+      header.SetAddressContext( GetAddressContext( ipv6->GetInterfaceForDevice( interface->GetDevice()), source));
       if( !packet->RemoveHeader( header)){
         NS_ABORT_MSG( "packet has no mchadv header");
       }
+      if( !header.IsValid()){
+        NS_LOG_LOGIC( Utility::Coloring( MAGENTA, "dropping mchadv of an unknown encoding from ")<< source);
+        return;
+      }
       auto mch_address= header.GetMchAddress();
       neighbor_headers.Update( mch_address, active_neighbor_timeout, header, position, velocity);
 
@@ -903,6 +1111,7 @@ namespace ns3{
       //NS_LOG_LOGIC( Utility::Coloring( CYAN, "receive from ")<< source);
 
       RgstreqHeader header;
+      header.SetAddressContext( GetAddressContext( ipv6->GetInterfaceForDevice( interface->GetDevice()), source));
       if( !packet->RemoveHeader( header)){
         NS_ABORT_MSG( "packet has no mchadv header");
       }
@@ -929,6 +1138,7 @@ namespace ns3{
       //NS_LOG_LOGIC( Utility::Coloring( CYAN, "receive from ")<< source);
 
       RgstrepHeader header;
+      header.SetAddressContext( GetAddressContext( ipv6->GetInterfaceForDevice( interface->GetDevice()), source));
       if( !packet->RemoveHeader( header)){
         NS_ABORT_MSG( "packet has no mchadv header");
       }
@@ -940,8 +1150,11 @@ namespace ns3{
         return;
       }
 
-      mcih_routing_table.SetGateway( header_address);
+      uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+      mcih_routing_table.SetGateway( header_address, source, if_index);
       SetRole( ClusterMember);
+      // a host address, members out of range of each other still go through the head
+      JoinClusterPrefix( header.GetClusterPrefix(), if_index, Ipv6Prefix( 128));
     }
 
     void RoutingProtocol::ReceiveResign( Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit){
@@ -949,6 +1162,7 @@ namespace ns3{
       //NS_LOG_LOGIC( Utility::Coloring( CYAN, "receive from ")<< source);
 
       ResignHeader header;
+      header.SetAddressContext( GetAddressContext( ipv6->GetInterfaceForDevice( interface->GetDevice()), source));
       if( !packet->RemoveHeader( header)){
         NS_ABORT_MSG( "packet has no chresign header");
       }
@@ -962,7 +1176,8 @@ namespace ns3{
 
       if( neighbor_headers.IsOwnClusterHead( addr)){
         NS_LOG_LOGIC( "own cluster head resigned, therefore launching intercluster handover scheme");
-        neighbor_headers.SetOwnClusterHead( Ipv6Address::GetAny());
+        neighbor_headers.ClearOwnClusterHead();
+        mcih_routing_table.ClearGateway();
         InterclusterHandover();
       }
 
@@ -974,6 +1189,39 @@ namespace ns3{
       }
     }
 
+    void RoutingProtocol::ReceiveRouteUpdate( Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit){
+      NS_LOG_FUNCTION( this<< source);
+
+      RouteUpdateHeader header;
+      if( !packet->RemoveHeader( header)){
+        NS_ABORT_MSG( "packet has no route update header");
+      }
+      NS_ASSERT_MSG( source.IsLinkLocal(), "route update packet comes from not link local address: "<< source);
+
+      uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+      const auto &rtes= header.GetRtes();
+      for( auto itr= rtes.begin(); itr!= rtes.end(); itr++){
+        if( IsOwnAddress( itr->prefix)) continue;
+        // only directly reached routes are sent, another head announcing the own prefix took the same cluster id
+        if( itr->prefix== cluster_prefix&& itr->prefix_length== CLUSTER_PREFIX_LENGTH&& itr->metric< RouteUpdateHeader::INFINITY_METRIC){
+          Simulator::ScheduleNow( &RoutingProtocol::RenumberCluster, this, cluster_prefix);
+          continue;
+        }
+        if( itr->metric>= RouteUpdateHeader::INFINITY_METRIC){
+          mcih_routing_table.RemoveRoute( itr->prefix, Ipv6Prefix( itr->prefix_length), source, if_index);
+          continue;
+        }
+        // one head away, behind the own routes of metric 1. learned routes are not relayed, there is no distance to count
+        Ptr< McihRoutingTableEntry> route= Create< McihRoutingTableEntry>( itr->prefix, Ipv6Prefix( itr->prefix_length), source, if_index, Ipv6Address::GetZero());
+        route->SetRouteTag( itr->tag);
+        route->SetRouteMetric( 2);
+        route->SetRouteStatus( McihRoutingTableEntry::McihValid);
+        route->SetRouteChanged( true);
+        // outlives a lost full refresh, withdrawals remove it earlier
+        mcih_routing_table.AddRoute( route, route_update_interval* 3);
+      }
+    }
+
     Ptr< Ipv6Route> RoutingProtocol::LoopbackRoute( const Ipv6Header &header, Ptr< NetDevice> output_interface) const{
       NS_LOG_FUNCTION( this<< Utility::Coloring( RED, "do not use this function"));
       NS_LOG_LOGIC( Utility::Coloring( CYAN, header));
@@ -1032,23 +1280,21 @@ namespace ns3{
 
       // Print( LOG_LEVEL_LOGIC, GREEN, neighbor_nodes.GetNdiscCache());
 
-      auto l3= ipv6->GetObject< Ipv6L3Protocol>();
-      auto interface= l3->GetInterface( 1);
-
       SendHello();
 
       switch( role){
         case Undecided:
           if( default_role!= role) SetRole( default_role);
-          interface->SetForwarding( false);
+          SetForwarding( false);
           if( neighbor_headers.GetNeighborNumber()){
-            SendRgstreq( neighbor_headers.GetLowestRpmNeighborAddress());// Ipv6Address::GetAllRoutersMulticast()); //neighbor_headers.GetLowestRpmNeighborAddress());
+            SendRgstreq( neighbor_headers.GetLowestRpmNeighborAddress(), neighbor_headers.GetLowestRpmNeighborAddress());// Ipv6Address::GetAllRoutersMulticast()); //neighbor_headers.GetLowestRpmNeighborAddress());
           }
           break;
 
         case ClusterMember:
           NS_LOG_LOGIC( Utility::Coloring( CYAN, "cluster member is not implement yet"));
           InterclusterHandover();
+          UpdateHeadRoutes();
           break;
 
         case SubClusterHead:
@@ -1057,16 +1303,12 @@ namespace ns3{
 
         case MasterClusterHead:
           NS_LOG_LOGIC( "role is master cluster head");
-          neighbor_headers.SetOwnClusterHead( Ipv6Address::GetAny());
-          if( interface){
-            interface->SetForwarding( true);
-          } else{
-            NS_LOG_LOGIC( Utility::Coloring( RED, "what is happend? interface was not found."));
-          }
+          neighbor_headers.ClearOwnClusterHead();
+          SetForwarding( true);
           if( cluster_members){ // is have some cluster member
             NS_LOG_FUNCTION("cluster size: "<< cluster_members->GetNeighborNumber());
           } else{
-            cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( hello_interval));
+            cluster_members= unique_ptr< ClusterMembers>( new ClusterMembers( neighbor_store));
           }
           if( cluster_members->GetNeighborNumber()){ // is have some cluster member
             EmptyCheckUpdate( contention_interval); // to extend the timer.
@@ -1119,6 +1361,18 @@ namespace ns3{
       empty_check_timer.Cancel();
     }
 
+    void RoutingProtocol::SetForwarding( bool forwarding){
+      for( auto itr= socket_interfaces.begin(); itr!= socket_interfaces.end(); itr++){
+        itr->second->SetForwarding( forwarding);
+      }
+    }
+
+    void RoutingProtocol::RouteUpdateTimerExpire(){
+      NS_LOG_FUNCTION( this);
+      DoSendRouteUpdate( true);
+      route_update_timer.Schedule( route_update_interval);
+    }
+
     void RoutingProtocol::SendTo( Ptr< Socket> socket, Ptr< Packet> packet, Ipv6Address destination){
       NS_LOG_FUNCTION( this<< packet->GetUid());
       auto interface= FindInterface( socket);
@@ -1134,8 +1388,73 @@ namespace ns3{
       }
     }
 
+    void RoutingProtocol::Queue( Ptr< Socket> socket, Ptr< Packet> packet, Ipv6Address destination){
+      PendingMessage message;
+      message.packet= packet;
+      message.destination= destination;
+      pending_messages[ socket].push_back( message);
+      if( !flush_event.IsRunning()) flush_event= Simulator::Schedule( Time( MilliSeconds( 5)), &RoutingProtocol::FlushMessages, this);
+    }
+
+    void RoutingProtocol::FlushMessages(){
+      NS_LOG_FUNCTION( this);
+      for( auto socket_itr= pending_messages.begin(); socket_itr!= pending_messages.end(); socket_itr++){
+        auto socket= socket_itr->first;
+        const auto &messages= socket_itr->second;
+
+        // one batch per destination, unicast stays unicast to keep the mac ack
+        vector< pair< Ipv6Address, vector< Ptr< Packet> > > > batches;
+        for( auto itr= messages.begin(); itr!= messages.end(); itr++){
+          auto batch= batches.begin();
+          while( batch!= batches.end()&& batch->first!= itr->destination) batch++;
+          if( batch== batches.end()) batch= batches.insert( batches.end(), make_pair( itr->destination, vector< Ptr< Packet> >()));
+          batch->second.push_back( itr->packet);
+        }
+
+        uint32_t if_index= ipv6->GetInterfaceForDevice( FindInterface( socket)->GetDevice());
+        uint32_t max_size= ipv6->GetMtu( if_index)- Ipv6Header().GetSerializedSize()- UdpHeader().GetSerializedSize()- TypeHeader().GetSerializedSize();
+        for( auto batch= batches.begin(); batch!= batches.end(); batch++){
+          const auto &packets= batch->second;
+          size_t first= 0;
+          while( first< packets.size()){
+            // as many messages as fit in the mtu, one alone goes out as it is
+            size_t last= first;
+            uint32_t size= 0;
+            while( last< packets.size()&& size+ TlvHeader().GetSerializedSize()+ packets[ last]->GetSize()- TypeHeader().GetSerializedSize()<= max_size){
+              size+= TlvHeader().GetSerializedSize()+ packets[ last]->GetSize()- TypeHeader().GetSerializedSize();
+              last++;
+            }
+            if( last- first<= 1){
+              SendTo( socket, packets[ first], batch->first);
+              first++;
+              continue;
+            }
+            auto aggregate= Create< Packet>();
+            for( size_t index= first; index< last; index++){
+              auto message= packets[ index]->Copy();
+              TypeHeader type;
+              message->RemoveHeader( type);
+              message->RemoveAllPacketTags();
+              message->AddHeader( TlvHeader( type.GetType(), message->GetSize()));
+              aggregate->AddAtEnd( message);
+            }
+            SocketIpv6HopLimitTag hoplimit_tag;
+            packets[ first]->PeekPacketTag( hoplimit_tag);
+            aggregate->AddPacketTag( hoplimit_tag);
+            aggregate->AddHeader( TypeHeader( MCIHTYPE_AGGREGATE));
+            NS_LOG_LOGIC( Utility::Coloring( CYAN, "aggregated ")<< last- first<< " messages to "<< batch->first);
+            SendTo( socket, aggregate, batch->first);
+            first= last;
+          }
+        }
+      }
+      pending_messages.clear();
+    }
+
     void RoutingProtocol::DoDispose(){
       NS_LOG_FUNCTION( this);
+      triggered_update_event.Cancel();
+      flush_event.Cancel();
       if( role!= Undecided){
         connectable.push_back( Simulator::Now()- become_connectable_time);
       }
@@ -1211,66 +1530,230 @@ namespace ns3{
       route->SetRouteStatus( McihRoutingTableEntry::McihValid);
       route->SetRouteChanged( true);
 
-      mcih_routing_table.AddRoute( route, EventId());
+      mcih_routing_table.AddRoute( route);
+    }
+
+    void RoutingProtocol::AddHostRouteTo( Ipv6Address destination, Ipv6Address next_hop, uint32_t if_index){
+      NS_LOG_FUNCTION( this<< destination<< next_hop<< if_index);
+
+      Ptr< McihRoutingTableEntry> route= Create< McihRoutingTableEntry>( destination, Ipv6Prefix( 128), next_hop, if_index, Ipv6Address::GetZero());
+      route->SetRouteMetric( 1);
+      route->SetRouteStatus( McihRoutingTableEntry::McihValid);
+      route->SetRouteChanged( true);
+
+      mcih_routing_table.AddRoute( route, active_route_timeout);
     }
 
     void RoutingProtocol::SendTriggeredRouteUpdate(){
       NS_LOG_FUNCTION (this);
+      if( triggered_update_event.IsRunning()){
+        NS_LOG_LOGIC( "skipping triggered update due to cooldown");
+        return;
+      }
+      // changes piling up during the hold down go out in one update
+      Time delay= Seconds( uniform_random_variable->GetValue( min_triggered_delay.GetSeconds(), max_triggered_delay.GetSeconds()));
+      triggered_update_event= Simulator::Schedule( delay, &RoutingProtocol::DoSendRouteUpdate, this, false);
+    }
 
-      /*
-         if( m_nextTriggeredUpdate.IsRunning()){
-         NS_LOG_LOGIC ("Skipping Triggered Update due to cooldown");
-         return;
-         }
-         Time delay = Seconds (m_rng->GetValue (m_minTriggeredUpdateDelay.GetSeconds (), m_maxTriggeredUpdateDelay.GetSeconds ()));
-         m_nextTriggeredUpdate = Simulator::Schedule (delay, &RipNg::DoSendRouteUpdate, this, false);
-         */
+    // global scope unicast, not the fe80::/64 and ::1 routes every interface brings up
+    static bool IsGlobalUnicast( Ipv6Address address){
+      if( address.IsMulticast()|| address.IsLinkLocal()|| address.IsLocalhost()) return false;
+      return address!= Ipv6Address::GetAny();
     }
 
     void RoutingProtocol::DoSendRouteUpdate( bool periodic){
       NS_LOG_FUNCTION( this<< ( periodic? "periodic": "triggered"));
-      NS_LOG_LOGIC( Utility::Coloring( RED, "updating route is not implementation yet."));
-      /*
-         for( auto itr= socket_interfaces.begin(); itr!= socket_interfaces.end(); itr++){
-         auto interface= itr->second;
-         auto if_index= ToIndex( interface);
-         if( interface_exclusions.find( if_index)== interface_exclusions.end()){
-         uint16_t mtu= ipv6->GetMtu( if_index);
-         uint16_t max_rte= mtu- Ipv6Header().GetSerializedSize()- UdpHeader().GetSerializedSize()- TypeHeader().GetSerializedSize(); // bug
-         Ptr< Packet> packet= Create< Packet>();
-         SocketIpv6HopLimitTag tag;
-         tag.SetHopLimit( 255);
+      if( role!= MasterClusterHead&& role!= SubClusterHead){ // members reach other clusters through their head
+        mcih_routing_table.ClearChanges();
+        return;
+      }
+      if( periodic) triggered_update_event.Cancel();
 
-         TypeHeader type;
-         }
-         }
-         */
+      // only the routes this head reaches itself, learned ones are never relayed so an update reaches the adjacent heads only
+      vector< Ptr< McihRoutingTableEntry> > entries;
+      mcih_routing_table.GetRoutes( entries, periodic);
+      const auto &withdrawn= mcih_routing_table.GetWithdrawnRoutes();
+
+      for( auto if_itr= socket_interfaces.begin(); if_itr!= socket_interfaces.end(); if_itr++){
+        auto socket= if_itr->first;
+        auto interface= if_itr->second;
+        uint32_t if_index= ipv6->GetInterfaceForDevice( interface->GetDevice());
+        uint32_t mtu= ipv6->GetMtu( if_index);
+        uint32_t max_rte= ( mtu- Ipv6Header().GetSerializedSize()- UdpHeader().GetSerializedSize()- TypeHeader().GetSerializedSize()- RouteUpdateHeader::GetEmptySize())/ RouteUpdateHeader::RTE_SIZE;
+
+        RouteUpdateHeader header;
+        auto flush= [&](){
+          if( !header.GetRteNumber()) return;
+          auto packet= Create< Packet>();
+          SocketIpv6HopLimitTag hoplimit_tag;
+          hoplimit_tag.SetHopLimit( 0);
+          packet->AddPacketTag( hoplimit_tag);
+          TypeHeader type( MCIHTYPE_RTUPDATE);
+          packet->AddHeader( header);
+          packet->AddHeader( type);
+          Queue( socket, packet, Ipv6Address::GetAllRoutersMulticast());
+          header= RouteUpdateHeader();
+        };
+        auto add= [&]( Ptr< McihRoutingTableEntry> entry, uint8_t metric){
+          if( entry->GetRouteMetric()> 1|| !IsGlobalUnicast( entry->GetDestNetwork())) return;
+          // reached through the prefix of its cluster, routes grow with clusters instead of vehicles
+          if( entry->GetDestNetworkPrefix().GetPrefixLength()> CLUSTER_PREFIX_LENGTH&& IsClusterAddress( entry->GetDestNetwork())) return;
+          header.AddRte( entry->GetDestNetwork(), entry->GetDestNetworkPrefix().GetPrefixLength(), metric, entry->GetRouteTag());
+          if( header.GetRteNumber()>= max_rte) flush();
+        };
+        for( auto itr= entries.begin(); itr!= entries.end(); itr++) add( *itr, ( *itr)->GetRouteMetric());
+        for( auto itr= withdrawn.begin(); itr!= withdrawn.end(); itr++) add( *itr, RouteUpdateHeader::INFINITY_METRIC);
+        flush();
+      }
+      mcih_routing_table.ClearChanges();
+    }
+
+
+    Ipv6Address RoutingProtocol::MakeClusterPrefix( uint32_t if_index){
+      // the cluster id comes from the interface id, a head takes the same prefix every time until a conflict salts it
+      uint8_t buffer[ 16];
+      cluster_prefix_base.CombinePrefix( Ipv6Prefix( CLUSTER_SPACE_LENGTH)).GetBytes( buffer);
+      // the salt is mixed into the whole hash, two heads colliding in 16 bits part with the next salt
+      uint64_t hash= Ipv6AddressHash()( GetAddress( if_index, Ipv6InterfaceAddress::LINKLOCAL))^ ( cluster_salt* 0x9e3779b97f4a7c15ULL);
+      hash^= hash>> 29;
+      hash*= 0xbf58476d1ce4e5b9ULL;
+      uint16_t cluster_id= hash^ ( hash>> 32);
+      buffer[ 6]= cluster_id>> 8;
+      buffer[ 7]= cluster_id& 0xff;
+      return Ipv6Address( buffer);
+    }
+
+    void RoutingProtocol::RenumberCluster( Ipv6Address prefix){
+      if( prefix!= cluster_prefix|| role!= MasterClusterHead) return; // renumbered or left meanwhile
+      NS_LOG_LOGIC( Utility::Coloring( RED, "cluster prefix conflict ")<< cluster_prefix<< ", renumbering");
+      cluster_salt++;
+      JoinClusterPrefix( MakeClusterPrefix( cluster_if_index), cluster_if_index, Ipv6Prefix( CLUSTER_PREFIX_LENGTH));
+      if( !cluster_members) return;
+      // members configure their address from the new prefix
+      cluster_members->ForEach( [ &]( const Neighbors::Neighbor &member){
+          Simulator::ScheduleNow( &RoutingProtocol::SendRgstrep, this, member.neighbor_address, member.neighbor_address);
+          });
+    }
+
+    void RoutingProtocol::JoinClusterPrefix( Ipv6Address prefix, uint32_t if_index, Ipv6Prefix mask){
+      if( prefix== cluster_prefix) return;
+      LeaveClusterPrefix();
+      if( prefix== Ipv6Address()) return;
+      NS_LOG_FUNCTION( this<< prefix<< if_index<< mask);
+
+      uint8_t address[ 16];
+      uint8_t interface_id[ 16];
+      prefix.GetBytes( address);
+      GetAddress( if_index, Ipv6InterfaceAddress::LINKLOCAL).GetBytes( interface_id);
+      memcpy( address+ 8, interface_id+ 8, 8);
+
+      cluster_prefix= prefix;
+      cluster_address= Ipv6InterfaceAddress( Ipv6Address( address), mask);
+      cluster_if_index= if_index;
+      // the cluster address goes out in hellos and as source, remote clusters reach it by the prefix
+      mcih_routing_table.SetPreferredPrefix( prefix, Ipv6Prefix( CLUSTER_PREFIX_LENGTH));
+      ipv6->AddAddress( if_index, cluster_address);
+    }
+
+    void RoutingProtocol::LeaveClusterPrefix(){
+      if( cluster_prefix== Ipv6Address()) return;
+      NS_LOG_FUNCTION( this<< cluster_prefix);
+      cluster_prefix= Ipv6Address();
+      mcih_routing_table.SetPreferredPrefix( Ipv6Address(), Ipv6Prefix());
+      ipv6->RemoveAddress( cluster_if_index, cluster_address.GetAddress());
+      if( role== MasterClusterHead|| role== SubClusterHead){ // withdrawn while still a head, it is not sent later
+        DoSendRouteUpdate( false);
+      }
     }
 
+    bool RoutingProtocol::IsClusterAddress( Ipv6Address address) const{
+      if( cluster_prefix_base== Ipv6Address()) return false;
+      return address.CombinePrefix( Ipv6Prefix( CLUSTER_SPACE_LENGTH))== cluster_prefix_base.CombinePrefix( Ipv6Prefix( CLUSTER_SPACE_LENGTH));
+    }
+
+    AddressContext RoutingProtocol::GetAddressContext( uint32_t if_index, Ipv6Address source){
+      AddressContext context;
+      context.source= source;
+      // the cluster addresses differ between nodes of a link, the prefix they share is the other global one
+      for( uint32_t ad_index= 0; ad_index< ipv6->GetNAddresses( if_index); ad_index++){
+        auto address= ipv6->GetAddress( if_index, ad_index);
+        if( address.GetScope()!= Ipv6InterfaceAddress::GLOBAL|| IsClusterAddress( address.GetAddress())) continue;
+        context.link_prefix= address.GetAddress().CombinePrefix( Ipv6Prefix( 64));
+        break;
+      }
+      if( cluster_prefix_base!= Ipv6Address()) context.cluster_space= cluster_prefix_base.CombinePrefix( Ipv6Prefix( CLUSTER_SPACE_LENGTH));
+      return context;
+    }
+
+    AddressContext RoutingProtocol::GetAddressContext( uint32_t if_index){
+      // the message may leave from the global address, the receiver only gets the interface id right when both agree
+      auto link_local= mcih_routing_table.GetAddress( if_index, Ipv6InterfaceAddress::LINKLOCAL);
+      auto global= mcih_routing_table.GetAddress( if_index, Ipv6InterfaceAddress::GLOBAL);
+      uint8_t link_local_bytes[ 16];
+      uint8_t global_bytes[ 16];
+      link_local.GetBytes( link_local_bytes);
+      global.GetBytes( global_bytes);
+      bool shared= global== Ipv6Address()|| !memcmp( link_local_bytes+ 8, global_bytes+ 8, 8);
+      return GetAddressContext( if_index, shared? link_local: Ipv6Address());
+    }
 
     bool RoutingProtocol::IsOwnAddress( Ipv6Address address){
-      for( size_t if_index= 0; if_index< ipv6->GetNInterfaces(); if_index++)
-        for( size_t ad_index= 0; ad_index< ipv6->GetNAddresses( if_index); ad_index++){
-          NS_LOG_LOGIC( Utility::Coloring( CYAN, address)<< " == "<<Utility::Coloring( CYAN, ipv6->GetAddress( if_index, ad_index)));
-          if( address== ipv6->GetAddress( if_index, ad_index).GetAddress())
-            return true;
-        }
-      return false;
+      return own_addresses.Find( address)!= own_addresses.NPOS;
     }
 
     void RoutingProtocol::InterclusterHandover(){
       NS_LOG_FUNCTION( this);
-      auto best= neighbor_headers.GetBestHeader();
+      const auto &best= neighbor_headers.GetBestHeader();
       if( !neighbor_headers.IsOwnClusterHead( best.neighbor_address)){ // searching new cluster head
-        auto och= neighbor_headers.GetOwnClusterHead();
+        const auto &och= neighbor_headers.GetOwnClusterHead();
         NS_LOG_LOGIC( Utility::Coloring( RED, "Handover")
             << " from "<< och.neighbor_address<< "("<< och.rsm<< ")"
             << " to "<< best.neighbor_address<< "("<< best.rsm<<")");
-        SendResign( neighbor_headers.GetOwnClusterHead().neighbor_address);
-        SendRgstreq( best.neighbor_address);
+        // the resign and the request go out in one link local multicast datagram, each names its receiver in the body.
+        // neither needs the mac ack, the old head also expires the member and the undecided role check repeats the request.
+        // a lost head is not told, the request then goes unicast alone
+        if( och.neighbor_address!= Ipv6Address()){
+          SendResign( Ipv6Address::GetAllRoutersMulticast());
+          SendRgstreq( Ipv6Address::GetAllRoutersMulticast(), best.neighbor_address);
+        } else{
+          SetRole( Undecided);
+          SendRgstreq( best.neighbor_address, best.neighbor_address);
+        }
+      } else if( role== ClusterMember&& best.neighbor_address== Ipv6Address()){ // lost the head with no other one around
+        SetRole( Undecided);
       }
     }
 
+    void RoutingProtocol::HandleHeaderFailure( const std::vector< NeighborStore::LinkFailure> &failures){
+      NS_LOG_FUNCTION( this<< failures.size());
+      // a whole platoon of heads may be lost in one purge, the handover runs once for the batch
+      bool own_cluster_head_lost= false;
+      for( auto itr= failures.begin(); itr!= failures.end(); itr++){
+        if( neighbor_headers.IsOwnClusterHead( itr->address)) own_cluster_head_lost= true;
+        mcih_routing_table.RemoveHead( itr->address);
+      }
+      if( !own_cluster_head_lost|| role!= ClusterMember) return;
+      NS_LOG_LOGIC( "own cluster head is out of range, therefore launching intercluster handover scheme");
+      neighbor_headers.ClearOwnClusterHead();
+      mcih_routing_table.ClearGateway();
+      InterclusterHandover();
+    }
+
+    void RoutingProtocol::UpdateHeadRoutes(){
+      if( heads_generation== neighbor_headers.GetGeneration()) return;
+      NS_LOG_FUNCTION( this);
+      vector< McihRoutingTable::Head> heads;
+      neighbor_headers.ForEachHeader( [ &]( const Neighbors::Neighbor &factor){
+          if( factor.link_local_address== Ipv6Address()) return; // known from mchadv only, no next hop
+          McihRoutingTable::Head head;
+          head.address= factor.neighbor_address;
+          head.next_hop= factor.link_local_address;
+          heads.push_back( head);
+          });
+      mcih_routing_table.SetHeads( heads);
+      heads_generation= neighbor_headers.GetGeneration();
+    }
+
     void RoutingProtocol::EmptyCheckUpdate( Time time){
       NS_LOG_FUNCTION( this<< time.GetMilliSeconds()/1000.0);
       if( empty_check_timer.IsRunning())
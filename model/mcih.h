@@ -19,6 +19,7 @@
 #include "mcih-utility.h"
 #include "mcih-neighbor.h"
 #include "mcih-packet.h"
+#include "mcih-duplicate-cache.h"
 
 namespace ns3{
   namespace mcih{
@@ -42,6 +43,9 @@ namespace ns3{
       public: // static public number
         static TypeId GetTypeId();
         static const uint32_t MCIH_PORT;
+        static const uint8_t CLUSTER_SPACE_LENGTH= 48; // of ClusterPrefix, the cluster id fills the next 16 bits
+        static const uint8_t CLUSTER_PREFIX_LENGTH= 64;
+        static const uint32_t CONTEXTUAL_ADDRESS_TYPES; // default of ContextualAddressTypes
 
       private: // private member variable
         Ptr< Ipv6> ipv6;
@@ -59,20 +63,52 @@ namespace ns3{
         Time velocity_check_interval;
         Time elect_mch_interval;
         Time contention_interval;
+        Time route_update_interval; // full route refresh between cluster heads
+        Time min_triggered_delay;
+        Time max_triggered_delay;
         Timer role_check_timer;
         Timer velocity_check_timer;
         Timer elect_mch_timer;
         Timer empty_check_timer;
+        Timer route_update_timer;
+        EventId triggered_update_event;
+        struct PendingMessage{
+          Ptr< Packet> packet; // with its type header
+          Ipv6Address destination;
+        };
+        std::map< Ptr< Socket>, std::vector< PendingMessage> > pending_messages; // sent together by the flush event
+        EventId flush_event;
         McihRoutingTable mcih_routing_table;
+        NeighborStore neighbor_store;
         NeighborNodes neighbor_nodes;
         NeighborHeaders neighbor_headers;
         std::unique_ptr< ClusterMembers> cluster_members;
         std::set< uint32_t> interface_exclusions;
+        SlotIndex< Ipv6Address, Ipv6AddressHash> own_addresses; // every address of the node to its interface index
+        DuplicateCache<> multicast_duplicates; // ( source, uid) of the multicast packets seen
         Ptr< UniformRandomVariable> uniform_random_variable;
         Vector position;
         Vector velocity;
         bool initialized;
         size_t unbound;
+        uint32_t max_routes;
+        uint64_t heads_generation; // generation of neighbor_headers the head routes were built from
+        Ipv6Address cluster_prefix_base; // :: disables cluster addressing
+        Ipv6Address cluster_prefix; // of the own cluster, Ipv6Address() without one
+        Ipv6InterfaceAddress cluster_address; // configured from cluster_prefix
+        uint32_t cluster_if_index;
+        uint16_t cluster_salt; // changes the cluster id after a conflict
+        Encoding encoding; // of hello, unadv and mchadv sent
+        bool out_of_compact_range; // raw is sent instead of a clamped compact encoding
+        Vector position_origin;
+        uint32_t contextual_address_types; // bit 1<< type, compressed against the link and cluster contexts
+        uint32_t hello_keyframe_interval; // hellos per keyframe, 1 or less sends no deltas
+        uint32_t hellos_since_keyframe;
+        uint8_t hello_keyframe_sequence;
+        bool hello_keyframe_needed; // a new neighbor has no keyframe of this node yet
+        bool hello_keyframe_requested; // a delta of a neighbor could not be resolved, asked in the next hello
+        Time hello_keyframe_time;
+        std::vector< HelloState> hello_keyframes; // last keyframe sent, indexed by interface
         Role default_role;
 
         std::vector< Time> connectable;
@@ -84,12 +120,15 @@ namespace ns3{
         void SendUnadv( Ipv6Address destination);
         void SendElectMch( Ipv6Address destination);
         void SendMchadv( Ipv6Address destination);
-        void SendRgstreq( Ipv6Address destination);
+        void SendRgstreq( Ipv6Address destination, Ipv6Address target);
         void SendRgstrep( Ipv6Address destination, Ipv6Address target);
         void SendHandover( Ipv6Address destination);
         void SendResign( Ipv6Address destination);
         void SetRole( Role r);
         void SetDefaultRole( Role r);
+        void SetCompactHeaders( bool compact){ encoding= compact? ENCODING_COMPACT: ENCODING_RAW;}
+        bool GetCompactHeaders() const{ return encoding== ENCODING_COMPACT;}
+        Encoding GetMessageEncoding(); // encoding, raw while the own motion is out of the compact range
 
       private: // private function
         void Start();
@@ -106,15 +145,36 @@ namespace ns3{
         void ReceiveRgstreq( Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit);
         void ReceiveRgstrep( Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit);
         void ReceiveResign( Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit);
+        void ReceiveRouteUpdate( Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit);
         Ptr< Ipv6Route> LoopbackRoute( const Ipv6Header &header, Ptr< NetDevice> output_interface) const;
         void RoleCheckTimerExpire();
         void VelocityCheckTimerExpire();
         void ElectMchTimerExpire();
         void EmptyCheckTimerExpire();
+        void RouteUpdateTimerExpire();
+        void SetForwarding( bool forwarding); // on every interface mcih runs on
         void SendTo( Ptr< Socket> socket, Ptr< Packet> packet, Ipv6Address destination);
+        // sent with the other messages queued to the socket in the same tick, as one datagram per destination
+        void Queue( Ptr< Socket> socket, Ptr< Packet> packet, Ipv6Address destination);
+        void FlushMessages();
+        void Dispatch( MessageType type, Ptr< Packet> packet, Ipv6Address source, Ptr< Ipv6Interface> interface, uint8_t hoplimit);
+        // decided on the raw message, the type byte and the body bytes peeked from the packet
+        bool Accept( uint8_t type, const uint8_t *body, uint32_t size, Ipv6Address source);
+        bool IsOwnTarget( const uint8_t *body, uint32_t size, Ipv6Address source); // the compressed address leading body
+        static const uint32_t PEEK_SIZE= 3+ 1+ 16; // tlv header, address modes and a leading address
+        // of the addresses in headers received from source, or sent when source is not given
+        AddressContext GetAddressContext( uint32_t if_index, Ipv6Address source);
+        AddressContext GetAddressContext( uint32_t if_index);
+        bool IsContextual( MessageType type) const{ return contextual_address_types& ( 1u<< type);}
         void AddNetworkRouteTo( Ipv6Address network_address, Ipv6Prefix network_prefix, uint32_t if_index); 
+        void AddHostRouteTo( Ipv6Address destination, Ipv6Address next_hop, uint32_t if_index);
         void SendTriggeredRouteUpdate();
         void DoSendRouteUpdate( bool periodic);
+        Ipv6Address MakeClusterPrefix( uint32_t if_index);
+        void RenumberCluster( Ipv6Address prefix); // prefix is taken by another head
+        void JoinClusterPrefix( Ipv6Address prefix, uint32_t if_index, Ipv6Prefix mask);
+        void LeaveClusterPrefix();
+        bool IsClusterAddress( Ipv6Address address) const;
         Ptr< Ipv6Interface> GetInterface( uint32_t if_index){
           return ipv6->GetObject< Ipv6L3Protocol>()->GetInterface( if_index);
         }
@@ -133,13 +193,9 @@ namespace ns3{
         void DoInitialize();
         bool IsOwnAddress( Ipv6Address address);
         Ipv6Address GetAddress( size_t if_index, Ipv6InterfaceAddress::Scope_e scope){
-          auto l3= ipv6->GetObject< Ipv6L3Protocol>();
-          auto interface= l3->GetInterface( if_index);
-          for( size_t ad_index= 0; ad_index< interface->GetNAddresses(); ad_index++){
-            auto address= interface->GetAddress( ad_index);
-            if( address.GetScope()== scope) return address.GetAddress();
-          }
-          NS_ABORT_MSG( "NO ADDRESS");
+          auto address= mcih_routing_table.GetAddress( if_index, scope);
+          if( address== Ipv6Address()) NS_ABORT_MSG( "NO ADDRESS");
+          return address;
         }
         Ptr< Ipv6Interface> ToInterface( uint32_t index){
           auto l3= ipv6->GetObject< Ipv6L3Protocol>();
@@ -154,6 +210,8 @@ namespace ns3{
           NS_ABORT_MSG( "no such interface");
         }
         void InterclusterHandover();
+        void HandleHeaderFailure( const std::vector< NeighborStore::LinkFailure> &failures);
+        void UpdateHeadRoutes();
         void EmptyCheckUpdate( Time time);
         void ElectMchUpdate( Time time);
     };
@@ -3,6 +3,12 @@
 // Include a header file from your module to test.
 #include "ns3/mcih.h"
 
+#include "ns3/mcih-packet.h"
+#include "ns3/mcih-slot-index.h"
+#include "ns3/mcih-prefix-trie.h"
+#include "ns3/mcih-duplicate-cache.h"
+#include "ns3/packet.h"
+
 // An essential include is test.h
 #include "ns3/test.h"
 
@@ -46,6 +52,540 @@ McihTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// serializes h and deserializes it into rx, which carries the receiver settings
+template <class T>
+static T
+RoundTrip (const T &h, T rx)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (h);
+  packet->RemoveHeader (rx);
+  return rx;
+}
+
+// a delta hello resolved against the keyframe of its sender gives the state the sender had
+class McihHelloDeltaTestCase : public TestCase
+{
+public:
+  McihHelloDeltaTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (Vector position, Vector velocity, uint32_t size, const char *branch);
+};
+
+McihHelloDeltaTestCase::McihHelloDeltaTestCase ()
+  : TestCase ("Mcih hello SetDelta/Resolve round trip")
+{
+}
+
+void
+McihHelloDeltaTestCase::Check (Vector position, Vector velocity, uint32_t size, const char *branch)
+{
+  using namespace mcih;
+  Vector origin (1000, 2000, 0);
+  HelloHeader hello;
+  hello.SetEncoding (ENCODING_COMPACT);
+  hello.SetOrigin (origin);
+  hello.SetAddress (Ipv6Address ("2001:db8::200:ff:fe00:1"));
+  hello.SetPosition (Vector (1100, 2050, 0));
+  hello.SetVelocity (Vector (10, 0, 0));
+  hello.SetRole (ClusterMember);
+  hello.SetKeyframe (7);
+  HelloState sent_keyframe = hello.GetState ();
+
+  HelloHeader receiver;
+  receiver.SetOrigin (origin);
+  HelloState keyframe = RoundTrip (hello, receiver).GetState ();
+  NS_TEST_ASSERT_MSG_EQ (keyframe.position_x, sent_keyframe.position_x, branch);
+  NS_TEST_ASSERT_MSG_EQ (keyframe.velocity_x, sent_keyframe.velocity_x, branch);
+
+  hello.SetPosition (Vector (origin.x + position.x, origin.y + position.y, 0));
+  hello.SetVelocity (velocity);
+  HelloState sent = hello.GetState ();
+  hello.SetDelta (sent_keyframe, 20); // 1 s after the keyframe
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSerializedSize (), size, branch);
+
+  HelloHeader delta = RoundTrip (hello, receiver);
+  NS_TEST_ASSERT_MSG_EQ (delta.GetEncoding (), ENCODING_DELTA, branch);
+  NS_TEST_ASSERT_MSG_EQ (delta.Resolve (keyframe), true, branch);
+  HelloState resolved = delta.GetState ();
+  NS_TEST_ASSERT_MSG_EQ (resolved.address, sent.address, branch);
+  NS_TEST_ASSERT_MSG_EQ (resolved.position_x, sent.position_x, branch);
+  NS_TEST_ASSERT_MSG_EQ (resolved.position_y, sent.position_y, branch);
+  NS_TEST_ASSERT_MSG_EQ (resolved.velocity_x, sent.velocity_x, branch);
+  NS_TEST_ASSERT_MSG_EQ (resolved.velocity_y, sent.velocity_y, branch);
+  NS_TEST_ASSERT_MSG_EQ (resolved.role_abs_cm, sent.role_abs_cm, branch);
+  NS_TEST_ASSERT_MSG_EQ_TOL (delta.GetPosition ().x, origin.x + position.x, 0.125, branch);
+  NS_TEST_ASSERT_MSG_EQ_TOL (delta.GetVelocity ().y, velocity.y, 0.005, branch);
+
+  // a delta against a keyframe the receiver does not have
+  HelloHeader other = RoundTrip (hello, receiver);
+  keyframe.keyframe++;
+  NS_TEST_ASSERT_MSG_EQ (other.Resolve (keyframe), false, branch);
+}
+
+void
+McihHelloDeltaTestCase::DoRun (void)
+{
+  // header, position and velocity sizes of each branch, rpm, rsm and role unchanged
+  Check (Vector (110, 50, 0), Vector (10, 0, 0), 4, "moved as the keyframe velocity");
+  Check (Vector (112, 51, 0), Vector (10.5, 0.2, 0), 4 + 2 + 2, "short position and velocity");
+  Check (Vector (300, -200, 0), Vector (-20, 15, 0), 4 + 4 + 4, "full position and velocity");
+  Check (Vector (112, 51, 0), Vector (-20, 15, 0), 4 + 2 + 4, "short position, full velocity");
+  Check (Vector (300, -200, 0), Vector (10.5, 0.2, 0), 4 + 4 + 2, "full position, short velocity");
+
+  using namespace mcih;
+  HelloHeader hello;
+  hello.SetEncoding (ENCODING_COMPACT);
+  hello.SetKeyframeRequest (true);
+  NS_TEST_ASSERT_MSG_EQ (RoundTrip (hello, HelloHeader ()).GetKeyframeRequest (), true, "keyframe request");
+  hello.SetKeyframeRequest (false);
+  NS_TEST_ASSERT_MSG_EQ (RoundTrip (hello, HelloHeader ()).GetKeyframeRequest (), false, "keyframe request");
+}
+
+// a message of an encoding newer than the receiver knows is marked invalid, not fatal
+class McihUnknownEncodingTestCase : public TestCase
+{
+public:
+  McihUnknownEncodingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+McihUnknownEncodingTestCase::McihUnknownEncodingTestCase ()
+  : TestCase ("Mcih unknown encodings mark headers invalid")
+{
+}
+
+void
+McihUnknownEncodingTestCase::DoRun (void)
+{
+  using namespace mcih;
+  const uint8_t message[] = { 0x0f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+  HelloHeader hello;
+  NS_TEST_ASSERT_MSG_EQ (Create<Packet> (message, sizeof message)->RemoveHeader (hello), 1, "hello");
+  NS_TEST_ASSERT_MSG_EQ (hello.IsValid (), false, "hello");
+  UnadvHeader unadv;
+  NS_TEST_ASSERT_MSG_EQ (Create<Packet> (message, sizeof message)->RemoveHeader (unadv), 1, "unadv");
+  NS_TEST_ASSERT_MSG_EQ (unadv.IsValid (), false, "unadv");
+  MchadvHeader mchadv;
+  NS_TEST_ASSERT_MSG_EQ (Create<Packet> (message, sizeof message)->RemoveHeader (mchadv), 1, "mchadv");
+  NS_TEST_ASSERT_MSG_EQ (mchadv.IsValid (), false, "mchadv");
+
+  // the keyframe request bit of hello is not part of the encoding
+  const uint8_t request[] = { HelloHeader::KEYFRAME_REQUEST | ENCODING_DELTA, 0, 0, 0 };
+  NS_TEST_ASSERT_MSG_EQ (Create<Packet> (request, sizeof request)->RemoveHeader (hello), 4, "hello request");
+  NS_TEST_ASSERT_MSG_EQ (hello.IsValid (), true, "hello request");
+  NS_TEST_ASSERT_MSG_EQ (hello.GetKeyframeRequest (), true, "hello request");
+}
+
+// a link where the source, the global prefix and the cluster space are all known
+static mcih::AddressContext
+MakeAddressContext (void)
+{
+  mcih::AddressContext context;
+  context.source = Ipv6Address ("fe80::200:ff:fe00:5");
+  context.link_prefix = Ipv6Address ("2001:db8:1:2::");
+  context.cluster_space = Ipv6Address ("2001:db8:ab::");
+  return context;
+}
+
+// every address compression mode round trips, with and without the context that selects it
+class McihAddressCompressorTestCase : public TestCase
+{
+public:
+  McihAddressCompressorTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (const char *address, const mcih::AddressContext *context, uint8_t mode, uint32_t size);
+  mcih::AddressContext m_context;
+};
+
+McihAddressCompressorTestCase::McihAddressCompressorTestCase ()
+  : TestCase ("Mcih address compressor round trip"),
+    m_context (MakeAddressContext ())
+{
+}
+
+void
+McihAddressCompressorTestCase::Check (const char *address, const mcih::AddressContext *context, uint8_t mode, uint32_t size)
+{
+  using namespace mcih;
+  Ipv6Address original (address);
+  uint8_t chosen = AddressCompressor::GetMode (original, context);
+  NS_TEST_ASSERT_MSG_EQ (uint32_t (chosen), uint32_t (mode), address);
+  NS_TEST_ASSERT_MSG_EQ (AddressCompressor::GetSize (chosen), size, address);
+
+  Buffer buffer;
+  buffer.AddAtStart (size);
+  Buffer::Iterator i = buffer.Begin ();
+  AddressCompressor::Write (i, chosen, original);
+  NS_TEST_ASSERT_MSG_EQ (i.GetDistanceFrom (buffer.Begin ()), size, address);
+
+  // the receiver knows the context whether the sender used it or not
+  Buffer::Iterator j = buffer.Begin ();
+  NS_TEST_ASSERT_MSG_EQ (AddressCompressor::Read (j, chosen, m_context), original, address);
+  uint8_t bytes[16];
+  buffer.CopyData (bytes, size);
+  NS_TEST_ASSERT_MSG_EQ (AddressCompressor::Decode (bytes, chosen, m_context), original, address);
+}
+
+void
+McihAddressCompressorTestCase::DoRun (void)
+{
+  using namespace mcih;
+  typedef AddressCompressor C;
+  const AddressContext *none = 0;
+  const AddressContext *context = &m_context;
+
+  Check ("::", none, C::UNSPECIFIED, 0);
+  Check ("::", context, C::UNSPECIFIED, 0);
+  // fe80:: is not the unspecified address, its zero interface id goes inline
+  Check ("fe80::", none, C::PREFIX_LINK_LOCAL | C::IID_INLINE, 8);
+  Check ("fe80::", context, C::PREFIX_LINK_LOCAL | C::IID_INLINE, 8);
+  Check ("fe80::1234:5678:9abc:def0", context, C::PREFIX_LINK_LOCAL | C::IID_INLINE, 8);
+  Check ("fe80::200:ff:fe00:7", none, C::PREFIX_LINK_LOCAL | C::IID_SHORT, 2);
+  Check ("fe80::200:ff:fe00:5", none, C::PREFIX_LINK_LOCAL | C::IID_SHORT, 2);
+  // the rfc 6282 form has the u/l bit clear and goes inline
+  Check ("fe80::ff:fe00:7", none, C::PREFIX_LINK_LOCAL | C::IID_INLINE, 8);
+  Check ("fe80::200:ff:fe00:5", context, C::PREFIX_LINK_LOCAL | C::IID_SOURCE, 0);
+
+  Check ("2001:db8:1:2:1234:5678:9abc:def0", none, C::PREFIX_INLINE | C::IID_INLINE, 16);
+  Check ("2001:db8:1:2:200:ff:fe00:7", none, C::PREFIX_INLINE | C::IID_SHORT, 10);
+  Check ("2001:db8:1:2::", none, C::PREFIX_INLINE | C::IID_ZERO, 8);
+  Check ("2001:db8:9:0:200:ff:fe00:5", context, C::PREFIX_INLINE | C::IID_SOURCE, 8);
+
+  Check ("2001:db8:1:2:1234:5678:9abc:def0", context, C::PREFIX_LINK | C::IID_INLINE, 8);
+  Check ("2001:db8:1:2:200:ff:fe00:7", context, C::PREFIX_LINK | C::IID_SHORT, 2);
+  Check ("2001:db8:1:2:200:ff:fe00:5", context, C::PREFIX_LINK | C::IID_SOURCE, 0);
+  Check ("2001:db8:1:2::", context, C::PREFIX_LINK | C::IID_ZERO, 0);
+
+  Check ("2001:db8:ab:42:1234:5678:9abc:def0", context, C::PREFIX_CLUSTER | C::IID_INLINE, 10);
+  Check ("2001:db8:ab:42:200:ff:fe00:9", context, C::PREFIX_CLUSTER | C::IID_SHORT, 4);
+  Check ("2001:db8:ab:42:200:ff:fe00:5", context, C::PREFIX_CLUSTER | C::IID_SOURCE, 2);
+  Check ("2001:db8:ab:42::", context, C::PREFIX_CLUSTER | C::IID_ZERO, 2);
+  Check ("2001:db8:ab:42:200:ff:fe00:9", none, C::PREFIX_INLINE | C::IID_SHORT, 10);
+}
+
+// the two address headers keep the first address mode in the high nibble and the first address
+// right after the mode byte, as the receive filter peeks it before deserializing
+class McihRegistrationLayoutTestCase : public TestCase
+{
+public:
+  McihRegistrationLayoutTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckRequest (const char *target, const char *regist, bool contextual);
+  void CheckReply (const char *head, const char *prefix, bool contextual);
+  void CheckFirst (Ptr<Packet> packet, Ipv6Address first, Ipv6Address second, const char *msg);
+  mcih::AddressContext m_context;
+};
+
+McihRegistrationLayoutTestCase::McihRegistrationLayoutTestCase ()
+  : TestCase ("Mcih registration headers address layout"),
+    m_context (MakeAddressContext ())
+{
+}
+
+void
+McihRegistrationLayoutTestCase::CheckFirst (Ptr<Packet> packet, Ipv6Address first, Ipv6Address second, const char *msg)
+{
+  using namespace mcih;
+  uint8_t bytes[1 + 16 + 16];
+  uint32_t size = packet->CopyData (bytes, sizeof bytes);
+  uint8_t first_mode = bytes[0] >> 4;
+  uint8_t second_mode = bytes[0] & 0xf;
+  NS_TEST_ASSERT_MSG_EQ (size, 1 + AddressCompressor::GetSize (first_mode) + AddressCompressor::GetSize (second_mode), msg);
+  NS_TEST_ASSERT_MSG_EQ (AddressCompressor::Decode (bytes + 1, first_mode, m_context), first, msg);
+  NS_TEST_ASSERT_MSG_EQ (AddressCompressor::Decode (bytes + 1 + AddressCompressor::GetSize (first_mode), second_mode, m_context), second, msg);
+}
+
+void
+McihRegistrationLayoutTestCase::CheckRequest (const char *target, const char *regist, bool contextual)
+{
+  using namespace mcih;
+  RgstreqHeader request;
+  request.SetTargetAddress (Ipv6Address (target));
+  request.SetRegistAddress (Ipv6Address (regist));
+  request.SetAddressContext (m_context, contextual);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (request);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), request.GetSerializedSize (), target);
+  CheckFirst (packet, Ipv6Address (target), Ipv6Address (regist), target);
+
+  RgstreqHeader received;
+  received.SetAddressContext (m_context);
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetTargetAddress (), Ipv6Address (target), target);
+  NS_TEST_ASSERT_MSG_EQ (received.GetRegistAddress (), Ipv6Address (regist), target);
+}
+
+void
+McihRegistrationLayoutTestCase::CheckReply (const char *head, const char *prefix, bool contextual)
+{
+  using namespace mcih;
+  RgstrepHeader reply;
+  reply.SetHeaderAddress (Ipv6Address (head));
+  reply.SetClusterPrefix (Ipv6Address (prefix));
+  reply.SetAddressContext (m_context, contextual);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (reply);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), reply.GetSerializedSize (), head);
+  CheckFirst (packet, Ipv6Address (head), Ipv6Address (prefix), head);
+
+  RgstrepHeader received;
+  received.SetAddressContext (m_context);
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetHeaderAddress (), Ipv6Address (head), head);
+  NS_TEST_ASSERT_MSG_EQ (received.GetClusterPrefix (), Ipv6Address (prefix), head);
+}
+
+void
+McihRegistrationLayoutTestCase::DoRun (void)
+{
+  // target and regist address of different sizes, so a swapped nibble or order shows
+  CheckRequest ("2001:db8:ab:42:200:ff:fe00:9", "2001:db8:1:2:1234:5678:9abc:def0", true);
+  CheckRequest ("2001:db8:ab:42:200:ff:fe00:9", "2001:db8:1:2:1234:5678:9abc:def0", false);
+  CheckRequest ("fe80::200:ff:fe00:5", "::", true);
+  CheckRequest ("::", "fe80::", false);
+
+  CheckReply ("2001:db8:1:2:200:ff:fe00:7", "2001:db8:ab:42::", true);
+  CheckReply ("2001:db8:1:2:200:ff:fe00:7", "2001:db8:ab:42::", false);
+  // a head without a cluster prefix
+  CheckReply ("2001:db8:ab:42::", "::", true);
+}
+
+// every key lands in the same bucket, so lookups have to probe past other keys and tombstones
+struct McihCollidingHash
+{
+  size_t operator() (uint32_t key) const { return 0; }
+};
+
+// the open addressing index keeps keys reachable across overwrites, erases and rehashes
+class McihSlotIndexTestCase : public TestCase
+{
+public:
+  McihSlotIndexTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+McihSlotIndexTestCase::McihSlotIndexTestCase ()
+  : TestCase ("Mcih slot index insert, overwrite and erase")
+{
+}
+
+void
+McihSlotIndexTestCase::DoRun (void)
+{
+  typedef mcih::SlotIndex<uint32_t, McihCollidingHash> Index;
+  Index index;
+  NS_TEST_ASSERT_MSG_EQ (index.Find (1), Index::NPOS, "empty");
+
+  index.Insert (1, 10);
+  index.Insert (2, 20);
+  index.Insert (3, 30);
+  NS_TEST_ASSERT_MSG_EQ (index.Size (), 3, "insert");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (3), 30, "insert");
+
+  index.Insert (2, 21);
+  NS_TEST_ASSERT_MSG_EQ (index.Size (), 3, "overwrite");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (2), 21, "overwrite");
+
+  // the key probed after a tombstone stays reachable, the tombstone is reused
+  NS_TEST_ASSERT_MSG_EQ (index.Erase (2), true, "erase");
+  NS_TEST_ASSERT_MSG_EQ (index.Erase (2), false, "erase twice");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (2), Index::NPOS, "erase");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (3), 30, "past a tombstone");
+  index.Insert (3, 31);
+  NS_TEST_ASSERT_MSG_EQ (index.Size (), 2, "overwrite past a tombstone");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (3), 31, "overwrite past a tombstone");
+  index.Insert (4, 40);
+  NS_TEST_ASSERT_MSG_EQ (index.Find (4), 40, "reuse a tombstone");
+
+  // enough keys to rehash a few times
+  for (uint32_t key = 100; key < 200; key++)
+    {
+      index.Insert (key, key * 2);
+    }
+  NS_TEST_ASSERT_MSG_EQ (index.Size (), 103, "rehash");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (1), 10, "rehash");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (199), 398, "rehash");
+  for (uint32_t key = 100; key < 200; key++)
+    {
+      index.Erase (key);
+    }
+  NS_TEST_ASSERT_MSG_EQ (index.Size (), 3, "erase all");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (150), Index::NPOS, "erase all");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (4), 40, "erase all");
+
+  index.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (index.Size (), 0, "clear");
+  NS_TEST_ASSERT_MSG_EQ (index.Find (1), Index::NPOS, "clear");
+}
+
+// the path compressed trie finds exact prefixes, matches shortest first and drops emptied nodes
+class McihPrefixTrieTestCase : public TestCase
+{
+public:
+  McihPrefixTrieTestCase ();
+
+private:
+  virtual void DoRun (void);
+  std::vector<int> *Find (const char *prefix, uint8_t length);
+  std::vector<int> &Insert (const char *prefix, uint8_t length);
+  std::vector<int> Match (const char *address);
+
+  mcih::PrefixTrie<int> m_trie;
+};
+
+McihPrefixTrieTestCase::McihPrefixTrieTestCase ()
+  : TestCase ("Mcih prefix trie insert, erase and match")
+{
+}
+
+std::vector<int> *
+McihPrefixTrieTestCase::Find (const char *prefix, uint8_t length)
+{
+  uint8_t bytes[16];
+  Ipv6Address (prefix).GetBytes (bytes);
+  return m_trie.Find (bytes, length);
+}
+
+std::vector<int> &
+McihPrefixTrieTestCase::Insert (const char *prefix, uint8_t length)
+{
+  uint8_t bytes[16];
+  Ipv6Address (prefix).GetBytes (bytes);
+  return m_trie.Insert (bytes, length);
+}
+
+// the values of every matching prefix followed by its length
+std::vector<int>
+McihPrefixTrieTestCase::Match (const char *address)
+{
+  uint8_t bytes[16];
+  Ipv6Address (address).GetBytes (bytes);
+  std::vector<int> matches;
+  m_trie.Match (bytes, [&matches] (uint8_t length, const std::vector<int> &values)
+                {
+                  matches.insert (matches.end (), values.begin (), values.end ());
+                  matches.push_back (length);
+                });
+  return matches;
+}
+
+void
+McihPrefixTrieTestCase::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8::", 32), 0, "empty");
+
+  Insert ("2001:db8::", 32).push_back (1);
+  Insert ("2001:db8:1::", 48).push_back (2);
+  Insert ("2001:db8:1:2::", 64).push_back (3);
+  // 2001:db8:1:: and 2001:db8:2:: first differ at bit 46, the edge is split there
+  Insert ("2001:db8:2::", 48).push_back (4);
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:1:2::", 64)->at (0), 3, "insert");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:2::", 48)->at (0), 4, "insert");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8::", 46)->empty (), true, "branch");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8::", 40), 0, "missing length");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:3::", 48), 0, "missing prefix");
+
+  // the bits past the length are masked, so the same values come back
+  Insert ("2001:db8:1:ffff::", 48).at (0) = 5;
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:1::", 48)->size (), 1, "overwrite");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:1::", 48)->at (0), 5, "overwrite");
+
+  std::vector<int> matches = Match ("2001:db8:1:2::9");
+  NS_TEST_ASSERT_MSG_EQ (matches.size (), 6, "match");
+  NS_TEST_ASSERT_MSG_EQ (matches[0], 1, "match shortest first");
+  NS_TEST_ASSERT_MSG_EQ (matches[1], 32, "match shortest first");
+  NS_TEST_ASSERT_MSG_EQ (matches[2], 5, "match");
+  NS_TEST_ASSERT_MSG_EQ (matches[3], 48, "match");
+  NS_TEST_ASSERT_MSG_EQ (matches[4], 3, "match longest last");
+  NS_TEST_ASSERT_MSG_EQ (matches[5], 64, "match longest last");
+  NS_TEST_ASSERT_MSG_EQ (Match ("2001:db9::1").size (), 0, "no match");
+
+  // an emptied node with a single child is dropped, its child stays reachable
+  uint8_t bytes[16];
+  Find ("2001:db8:1::", 48)->clear ();
+  Ipv6Address ("2001:db8:1::").GetBytes (bytes);
+  m_trie.Compact (bytes, 48);
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:1::", 48), 0, "compact");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:1:2::", 64)->at (0), 3, "compact");
+  NS_TEST_ASSERT_MSG_EQ (Match ("2001:db8:1:2::9").size (), 4, "compact");
+
+  // removing the last route below the branch drops the branch too
+  Find ("2001:db8:1:2::", 64)->clear ();
+  Ipv6Address ("2001:db8:1:2::").GetBytes (bytes);
+  m_trie.Compact (bytes, 64);
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:1:2::", 64), 0, "compact leaf");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8::", 46), 0, "compact branch");
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8:2::", 48)->at (0), 4, "compact branch");
+  NS_TEST_ASSERT_MSG_EQ (Match ("2001:db8:1:2::9").size (), 2, "compact branch");
+  int prefixes = 0;
+  m_trie.ForEach ([&prefixes] (std::vector<int> &values) { prefixes++; });
+  NS_TEST_ASSERT_MSG_EQ (prefixes, 2, "compact branch");
+
+  m_trie.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (Find ("2001:db8::", 32), 0, "clear");
+}
+
+// the duplicate cache remembers the last pairs only, its filter forgets the pairs the ring overwrites
+class McihDuplicateCacheTestCase : public TestCase
+{
+public:
+  McihDuplicateCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+McihDuplicateCacheTestCase::McihDuplicateCacheTestCase ()
+  : TestCase ("Mcih duplicate cache window and filter")
+{
+}
+
+void
+McihDuplicateCacheTestCase::DoRun (void)
+{
+  mcih::DuplicateCache<4> cache;
+  Ipv6Address a ("2001:db8::1");
+  Ipv6Address b ("2001:db8::2");
+
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 1), false, "first");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 1), true, "again");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (b, 1), false, "other source");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 2), false, "other sequence");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 3), false, "full");
+
+  // the ring wraps, the oldest pair is overwritten and forgotten
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 4), false, "wrap");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (b, 1), true, "wrap");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 4), true, "wrap");
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 1), false, "overwritten");
+
+  // through many wraps, the counters of an overwritten pair are taken back and never those of a live one
+  for (uint32_t sequence = 10; sequence < 10000; sequence++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (sequence % 2 ? a : b, sequence), false, "new");
+      for (uint32_t live = sequence > 13 ? sequence - 3 : 10; live <= sequence; live++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (live % 2 ? a : b, live), true, "live");
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (a, 9995), false, "overwritten");
+
+  cache.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (cache.IsDuplicate (b, 9998), false, "clear");
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +601,13 @@ McihTestSuite::McihTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new McihTestCase1, TestCase::QUICK);
+  AddTestCase (new McihHelloDeltaTestCase, TestCase::QUICK);
+  AddTestCase (new McihUnknownEncodingTestCase, TestCase::QUICK);
+  AddTestCase (new McihAddressCompressorTestCase, TestCase::QUICK);
+  AddTestCase (new McihRegistrationLayoutTestCase, TestCase::QUICK);
+  AddTestCase (new McihSlotIndexTestCase, TestCase::QUICK);
+  AddTestCase (new McihPrefixTrieTestCase, TestCase::QUICK);
+  AddTestCase (new McihDuplicateCacheTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite